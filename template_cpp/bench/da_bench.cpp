@@ -0,0 +1,402 @@
+// da_bench: microbenchmarks of the link / broadcast building blocks, JSON on stdout.
+//
+//   cmake --build <build dir> --target da_bench
+//   <build dir>/bench/da_bench [--filter <substring>] [--repeat <k>] > bench.json
+//
+// Every case runs `repeat` times on fresh objects and reports the median and the spread
+// in nanoseconds per unit (a message, a packet or a call; see "unit"). Build with
+// -DCMAKE_BUILD_TYPE=Release for numbers worth comparing; "optimized" in the output
+// records whether it was.
+
+#include "common/logger.hpp"
+#include "common/types.hpp"
+#include "network/message.hpp"
+#include "network/peer_directory.hpp"
+#include "network/transport.hpp"
+#include "perfectlink/perfect_link_app.hpp"
+#include "fifobroadcast/fifo_broadcast_app.hpp"
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static volatile size_t sink;  // keeps results alive across the timed loops
+static std::string work_dir;
+
+static double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static std::string temp_path(const char* name)
+{
+    std::string path = work_dir + "/" + name;
+    std::remove(path.c_str());
+    return path;
+}
+
+static std::vector<Host> make_hosts(uint32_t n)
+{
+    std::vector<Host> hosts;
+    for (uint32_t i = 1; i <= n; i++)
+    {
+        hosts.emplace_back(i, "127.0.0.1", static_cast<uint16_t>(13000 + i));
+    }
+    return hosts;
+}
+
+// Datagram sink: counts what would have gone out and lets a hook act on it (e.g. ACK it).
+// receive() just blocks until close(); nothing ever arrives.
+class BenchTransport : public Transport
+{
+public:
+    std::function<void(const std::vector<uint8_t>&)> on_send;
+    std::atomic<uint64_t> packets{0};
+
+    void send(const sockaddr_in&, const std::vector<uint8_t>& data) override
+    {
+        packets++;
+        if (on_send) on_send(data);
+    }
+
+    size_t receive(std::vector<uint8_t>&, sockaddr_in&) override
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return closed_; });
+        throw std::runtime_error("Failed to receive data");
+    }
+
+    void close() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool closed_ = false;
+};
+
+// Seqs in DATA-type packets, without a full decode: [type u8][sender u32][count u8]...
+static uint64_t data_messages(const std::vector<uint8_t>& data)
+{
+    return data.size() > 5 ? data[5] : 0;
+}
+
+struct Case
+{
+    const char* name;
+    const char* unit;
+    uint64_t units;
+    std::function<double()> run;  // seconds for `units` units
+};
+
+// ======================
+// Codec
+// ======================
+
+static Packet sample_packet()
+{
+    Packet packet = Packet::createDataPacket(2, {101, 102, 103, 104, 105, 106, 107, 108});
+    packet.type = MessageType::BROADCAST_DATA;
+    for (uint32_t i = 0; i < 8; i++) packet.acks.emplace_back(3, 500 + i);
+    return packet;
+}
+
+static double bench_serialize(uint64_t units)
+{
+    Packet packet = sample_packet();
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < units; i++)
+    {
+        packet.seq_numbers[0] = static_cast<uint32_t>(i);
+        sink = sink + packet.serialize().size();
+    }
+    return seconds_since(start);
+}
+
+static double bench_deserialize(uint64_t units)
+{
+    std::vector<uint8_t> bytes = sample_packet().serialize();
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < units; i++)
+    {
+        sink = sink + Packet::deserialize(bytes).acks.size();
+    }
+    return seconds_since(start);
+}
+
+// ======================
+// Receiver / Logger
+// ======================
+
+// Every DATA packet (8 seqs from process 2) arrives twice, so half the messages are
+// duplicates; units are packets. Deliveries go through a real Logger.
+static double bench_receiver_handle(uint64_t units)
+{
+    PeerDirectory peers(make_hosts(3));
+    BenchTransport transport;
+    Logger logger(temp_path("receiver.output"));
+    milestone1::Receiver receiver(&transport, peers, &logger);
+    std::vector<uint32_t> seqs(8);
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < units; i++)
+    {
+        uint32_t base = static_cast<uint32_t>(i / 2) * 8 + 1;
+        for (uint32_t k = 0; k < 8; k++) seqs[k] = base + k;
+        receiver.handle(Packet::createDataPacket(2, seqs), 1);
+    }
+    logger.flush();
+    return seconds_since(start);
+}
+
+static double bench_logger(uint64_t units)
+{
+    Logger logger(temp_path("logger.output"));
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < units; i++)
+    {
+        logger.logDelivery(2, static_cast<uint32_t>(i + 1));
+    }
+    logger.flush();
+    return seconds_since(start);
+}
+
+// ======================
+// Sender
+// ======================
+
+// send() on a Sender whose threads are not running: queueing and broadcast logging only.
+static double bench_sender_enqueue(uint64_t units)
+{
+    PeerDirectory peers(make_hosts(2));
+    BenchTransport transport;
+    milestone1::Sender sender(&transport, 1, peers.at(1), nullptr);
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < units; i++)
+    {
+        sender.send(1, static_cast<uint32_t>(i + 1));
+    }
+    return seconds_since(start);
+}
+
+// Full enqueue -> batch -> transmit -> ACK -> unacked cleanup cycle. The transport ACKs every
+// DATA packet on the spot (from the send thread, which holds no Sender lock there).
+static double bench_sender_ack(uint64_t units)
+{
+    PeerDirectory peers(make_hosts(2));
+    BenchTransport transport;
+    milestone1::Sender sender(&transport, 1, peers.at(1), nullptr);
+    transport.on_send = [&sender](const std::vector<uint8_t>& data) {
+        sender.handleAck(Packet::createAckPacket(Packet::deserialize(data).seq_numbers));
+    };
+    sender.start();
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < units; i++)
+    {
+        sender.send(1, static_cast<uint32_t>(i + 1));
+    }
+    while (!sender.allMessagesAcked()) std::this_thread::yield();
+    double seconds = seconds_since(start);
+    sender.stop();
+    return seconds;
+}
+
+// One retransmission round of `units` unacked messages. The first retransmitted packet is
+// held in the transport until every message's timer has expired, so the round then runs
+// back to back and measures timer-queue and unacked-map bookkeeping, not the TIMEOUT pacing.
+static double bench_sender_retransmit(uint64_t units)
+{
+    PeerDirectory peers(make_hosts(2));
+    BenchTransport transport;
+    milestone1::Sender sender(&transport, 1, peers.at(1), nullptr);
+    std::mutex gate_mutex;
+    std::condition_variable gate_cv;
+    bool gate_open = false;
+    bool gate_waiting = false;
+    std::atomic<uint64_t> messages{0};
+    Clock::time_point released;
+    std::atomic<bool> finished{false};
+    Clock::time_point done;
+    transport.on_send = [&](const std::vector<uint8_t>& data) {
+        uint64_t before = messages.fetch_add(data_messages(data));
+        if (before == units)
+        {
+            std::unique_lock<std::mutex> lock(gate_mutex);
+            gate_waiting = true;
+            gate_cv.notify_all();
+            gate_cv.wait(lock, [&] { return gate_open; });
+        }
+        if (before + data_messages(data) >= 2 * units && !finished.exchange(true)) done = Clock::now();
+    };
+    sender.start();
+    for (uint64_t i = 0; i < units; i++)
+    {
+        sender.send(1, static_cast<uint32_t>(i + 1));
+    }
+    auto first_pass = Clock::now();
+    while (messages.load() < units) std::this_thread::yield();
+    auto first_pass_time = Clock::now() - first_pass;
+    {
+        std::unique_lock<std::mutex> lock(gate_mutex);
+        gate_cv.wait(lock, [&] { return gate_waiting; });
+    }
+    auto expired = Clock::now() + first_pass_time + std::chrono::milliseconds(20);
+    while (Clock::now() < expired) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    {
+        std::lock_guard<std::mutex> lock(gate_mutex);
+        gate_open = true;
+        released = Clock::now();
+    }
+    gate_cv.notify_all();
+    while (!finished.load()) std::this_thread::yield();
+    sender.stop();
+    return std::chrono::duration<double>(done - released).count();
+}
+
+// ======================
+// FIFO broadcast
+// ======================
+
+// URB + FIFO delivery at process 1 of 3 (flood mode) for origin 2's messages, each packet
+// arriving from process 2 and then from process 3 (the majority). block_reversed > 0 sends
+// every block of that many seqs last batch first, so all but one batch waits in pending_.
+static double bench_fifo(uint64_t units, uint32_t block)
+{
+    std::vector<Host> hosts = make_hosts(3);
+    sockaddr_in from[2];
+    for (int p = 0; p < 2; p++)
+    {
+        std::memset(&from[p], 0, sizeof(from[p]));
+        from[p].sin_family = AF_INET;
+        from[p].sin_port = htons(hosts[static_cast<size_t>(p) + 1].port);
+        inet_pton(AF_INET, "127.0.0.1", &from[p].sin_addr);
+    }
+    uint32_t batches = static_cast<uint32_t>(units / 8);
+    std::vector<std::vector<uint8_t>> datagrams;
+    uint32_t per_block = block > 0 ? block / 8 : 1;
+    for (uint32_t b = 0; b < batches; b++)
+    {
+        uint32_t in_block = b % per_block;
+        uint32_t batch = block > 0 ? b - in_block + (per_block - 1 - in_block) : b;
+        std::vector<uint32_t> seqs;
+        for (uint32_t k = 0; k < 8; k++) seqs.push_back(batch * 8 + k + 1);
+        Packet packet = Packet::createDataPacket(2, seqs);
+        packet.type = MessageType::BROADCAST_DATA;
+        datagrams.push_back(packet.serialize());
+    }
+
+    BenchTransport* transport = new BenchTransport();
+    milestone2::FIFOBroadcastApp app(1, hosts, 0, temp_path("fifo.output"), RuntimeOptions(), transport);
+    auto start = Clock::now();
+    for (const std::vector<uint8_t>& datagram : datagrams)
+    {
+        app.handleDatagram(datagram, from[0]);
+        app.handleDatagram(datagram, from[1]);
+    }
+    app.shutdown();
+    return seconds_since(start);
+}
+
+// ======================
+// Driver
+// ======================
+
+static void print_escaped(const char* text)
+{
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\') putchar('\\');
+        putchar(*c);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    int repeat = 5;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--filter <substring>] [--repeat <k>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    char dir_template[] = "/tmp/da_bench.XXXXXX";
+    if (mkdtemp(dir_template) == nullptr)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    work_dir = dir_template;
+
+    const std::vector<Case> cases = {
+        {"codec.serialize", "packet", 1000000, [] { return bench_serialize(1000000); }},
+        {"codec.deserialize", "packet", 1000000, [] { return bench_deserialize(1000000); }},
+        {"receiver.handle_dedupe", "packet", 100000, [] { return bench_receiver_handle(100000); }},
+        {"logger.log_delivery", "line", 200000, [] { return bench_logger(200000); }},
+        {"sender.enqueue", "message", 1000000, [] { return bench_sender_enqueue(1000000); }},
+        {"sender.send_ack_cycle", "message", 200000, [] { return bench_sender_ack(200000); }},
+        {"sender.retransmit_round", "message", 50000, [] { return bench_sender_retransmit(50000); }},
+        {"fifo.deliver_in_order", "message", 80000, [] { return bench_fifo(80000, 0); }},
+        {"fifo.deliver_reordered", "message", 80000, [] { return bench_fifo(80000, 256); }},
+    };
+
+#ifdef __OPTIMIZE__
+    const char* optimized = "true";
+#else
+    const char* optimized = "false";
+#endif
+    printf("{\n  \"compiler\": \"");
+    print_escaped(__VERSION__);
+    printf("\",\n  \"optimized\": %s,\n  \"repeat\": %d,\n  \"timestamp\": %ld,\n  \"benchmarks\": [",
+           optimized, repeat, static_cast<long>(time(nullptr)));
+    bool first = true;
+    for (const Case& c : cases)
+    {
+        if (!filter.empty() && std::string(c.name).find(filter) == std::string::npos) continue;
+        std::vector<double> ns;
+        for (int r = 0; r < repeat; r++)
+        {
+            ns.push_back(c.run() * 1e9 / static_cast<double>(c.units));
+        }
+        std::sort(ns.begin(), ns.end());
+        double median = ns[ns.size() / 2];
+        fprintf(stderr, "%-26s %10.1f ns/%s\n", c.name, median, c.unit);
+        printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"units\": %lu, \"median_ns\": %.2f, "
+               "\"min_ns\": %.2f, \"max_ns\": %.2f}",
+               first ? "" : ",", c.name, c.unit, static_cast<unsigned long>(c.units), median, ns.front(),
+               ns.back());
+        first = false;
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef LATENCY_TRACER_HPP
+#define LATENCY_TRACER_HPP
+
+#include "common/types.hpp"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Sampled end-to-end latency for broadcast messages (DA_TRACE=<k>).
+//
+// Sampling is by seq (seq % k == 0), so every process agrees on the sample without
+// coordination and unsampled messages cost one modulo. The origin stamps a sampled
+// message when it logs the broadcast; whoever sends that message on (origin or relay)
+// attaches the stamp to the BROADCAST_DATA packet while it still knows it. Receivers
+// record broadcast->URB-deliver and broadcast->FIFO-deliver per origin into
+// metrics::OriginHistogram, in whichever order the stamp and the deliveries happen.
+// A sample whose stamp never arrives is dropped once MAX_PENDING newer ones are waiting.
+class LatencyTracer
+{
+public:
+    explicit LatencyTracer(uint32_t sample_every);
+
+    bool sampled(uint32_t seq) const { return seq % sample_every_ == 0; }
+    static uint64_t nowMicros();
+
+    void stampBroadcast(uint32_t origin_id, uint32_t seq);
+    void learnStamps(uint32_t origin_id, const std::vector<TraceStamp>& stamps);
+    // Appends the stamps this process knows for seqs (all from origin_id) to out.
+    void attachStamps(uint32_t origin_id, const std::vector<uint32_t>& seqs,
+                      std::vector<TraceStamp>& out) const;
+    void urbDelivered(uint32_t origin_id, uint32_t seq);
+    void fifoDelivered(uint32_t origin_id, uint32_t seq);
+
+private:
+    struct Sample
+    {
+        uint64_t broadcast_us = 0;  // 0: stamp not seen yet
+        uint64_t urb_us = 0;
+        uint64_t fifo_us = 0;
+    };
+
+    uint32_t sample_every_;
+    mutable std::mutex mtx_;
+    std::map<uint64_t, Sample> samples_;  // (origin, seq) -> what is known so far
+    // origin -> last FIFO-delivered sampled seq. FIFO delivery is in seq order, so anything
+    // at or below it is finished and late stamps (from other relays) are ignored.
+    std::map<uint32_t, uint32_t> fifo_through_;
+
+    static constexpr size_t MAX_PENDING = 4096;
+
+    bool finished(uint32_t origin_id, uint32_t seq) const;
+    Sample& sampleFor(uint32_t origin_id, uint32_t seq);
+    void recordIfComplete(uint32_t origin_id, uint32_t seq);
+};
+
+#endif
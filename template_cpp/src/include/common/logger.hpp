@@ -1,6 +1,7 @@
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
+#include "common/runtime_options.hpp"
 #include <string>
 #include <vector>
 #include <mutex>
@@ -9,20 +10,53 @@
 class Logger {
 public:
     //构造函数，创建时自动运行
-    explicit Logger(const std::string& output_path);
+    explicit Logger(const std::string& output_path, LogFormat format = LogFormat::TEXT);
     //析构函数，销毁时自动执行
     ~Logger();
 
     void logBroadcast(uint32_t seq_number);
     void logDelivery(uint32_t sender_id, uint32_t seq_number);
+    // Lattice agreement: one line per shot, decided values separated by spaces (TEXT only)
+    void logDecision(const std::vector<uint32_t>& values);
     void flush();
+    // Final flush. In RANGES mode this expands <output>.ranges into the text output, removes
+    // it and switches to TEXT, so anything logged afterwards still lands after it. Idempotent.
+    void close();
+
+    // Streams a RANGES file into text lines appended to text_path; a record cut short by a
+    // crash ends the expansion. Returns the number of lines written, or -1 if ranges_path
+    // can't be read.
+    static int64_t expandRanges(const std::string& ranges_path, const std::string& text_path);
 
 private:
     void flushInternal();
+    void appendEvent(uint32_t tag, uint32_t seq_number);
+    void closeRun();
+    void writeRanges();
 
     std::string output_path_;
-    std::vector<std::string> buffer_;
-    static constexpr size_t FLUSH_THRESHOLD = 5; 
+    LogFormat format_;
+    int output_fd_;  // opened (O_APPEND) on the first flush, kept until destruction
+    // TEXT: pending lines back to back, newline-terminated, written out once they reach
+    // TEXT_FLUSH_BYTES (a few hundred delivery lines per write). clear() keeps the capacity,
+    // and the reserve covers the threshold plus a b/d line, so logging them doesn't allocate.
+    std::string text_;
+    size_t text_lines_;
+    static constexpr size_t TEXT_FLUSH_BYTES = 4096;
+    static constexpr size_t TEXT_RESERVE_BYTES = TEXT_FLUSH_BYTES + 64;
+
+    // RANGES: the open run (tag 0 = broadcasts, otherwise the sender id), encoded runs not
+    // yet written, and per tag where the previous run ended (runs store first_seq relative
+    // to it, which is 0 for FIFO deliveries).
+    std::string ranges_path_;
+    int ranges_fd_;
+    uint32_t run_tag_;
+    uint32_t run_first_;
+    uint32_t run_count_;
+    std::vector<uint8_t> ranges_buffer_;
+    std::vector<uint32_t> ranges_next_;
+    static constexpr size_t RANGES_WRITE_BYTES = 64 * 1024;
+
     // 创建锁变量
     std::mutex mtx_;
     
@@ -30,4 +64,4 @@ private:
     Logger& operator=(const Logger&) = delete;
 };
 
-#endif
\ No newline at end of file
+#endif
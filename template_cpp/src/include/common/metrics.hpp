@@ -0,0 +1,173 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Process-wide counters and latency histograms.
+//
+// Every thread that records an event gets its own cache-line-aligned Slab (registered on
+// first use, kept until exit), so the hot path is a thread_local load plus a non-atomic
+// add: no lock prefix and no line shared with another writer. Readers sum all slabs with
+// relaxed loads, which is exact enough for monitoring. Histograms use HDR-style log
+// buckets (16 linear sub-buckets per power of two, i.e. <= 6.25% relative error).
+namespace metrics
+{
+
+enum class Counter : uint32_t
+{
+    PACKETS_SENT,
+    BYTES_SENT,
+    PACKETS_RECEIVED,
+    BYTES_RECEIVED,
+    GSO_SENDS,             // segmented sends handed to the kernel as one UDP_SEGMENT buffer
+    GRO_RECEIVES,          // receives that returned several coalesced datagrams (UDP_GRO)
+    DATA_PACKETS_SENT,     // DATA packets from link Senders, retransmissions included
+    RETRANSMISSIONS,       // messages resent after TIMEOUT
+    ACK_PACKETS_SENT,      // standalone ACK / BROADCAST_ACK packets
+    ACKS_PIGGYBACKED,      // ACKs carried on reverse BROADCAST_DATA
+    ACKS_RECEIVED,         // unacked messages cleared by an ACK
+    DELIVERIES,
+    PAYLOAD_MISMATCHES,    // DA_PAYLOAD messages relayed without their own body
+    LOG_WRITES,            // write calls on the output (text) or <output>.ranges file
+    LOG_BYTES,
+    SHUTDOWN_US,           // stop signal (or a sender's last ACK) -> shutdown() returned
+    COUNT
+};
+
+enum class PeerCounter : uint32_t
+{
+    PACKETS_SENT,
+    PACKETS_RECEIVED,
+    RETRANSMISSIONS,
+    COUNT
+};
+
+enum class Histogram : uint32_t
+{
+    ACK_RTT_US,            // first transmission -> ACK, never-retransmitted messages only (Karn)
+    ACK_BATCH_SIZE,        // ACKs per standalone ACK packet
+    SEND_QUEUE_DEPTH,      // Sender pending_queue_ when sendLoop takes a batch
+    UNACKED_DEPTH,         // Sender unacked_messages_ after a batch is sent
+    FIFO_HOLDBACK_US,      // URB-delivered out of order -> FIFO-delivered
+    DECISION_LATENCY_US,   // lattice shot started -> decided
+    COUNT
+};
+
+// Per-origin end-to-end latency from sampled trace stamps (LatencyTracer). Samples are
+// rare, so these live in one mutex-protected table keyed by origin id, not in the slabs.
+enum class OriginHistogram : uint32_t
+{
+    BROADCAST_TO_URB_US,
+    BROADCAST_TO_FIFO_US,
+    COUNT
+};
+
+static constexpr size_t MAX_PEERS = 128;
+static constexpr uint32_t SUB_BUCKET_BITS = 4;
+static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+static constexpr uint32_t MAX_EXPONENT = 47;  // values >= 2^48 land in the last bucket
+static constexpr size_t HISTOGRAM_BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+static constexpr size_t COUNTERS = static_cast<size_t>(Counter::COUNT);
+static constexpr size_t PEER_COUNTERS = static_cast<size_t>(PeerCounter::COUNT);
+static constexpr size_t HISTOGRAMS = static_cast<size_t>(Histogram::COUNT);
+static constexpr size_t ORIGIN_HISTOGRAMS = static_cast<size_t>(OriginHistogram::COUNT);
+
+inline size_t bucketOf(uint64_t value)
+{
+    if (value < SUB_BUCKETS) return static_cast<size_t>(value);
+    uint32_t exponent = 63u - static_cast<uint32_t>(__builtin_clzll(value));
+    if (exponent > MAX_EXPONENT) return HISTOGRAM_BUCKETS - 1;
+    uint32_t sub = static_cast<uint32_t>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+// Largest value that maps to bucket (what percentiles report).
+uint64_t bucketUpperBound(size_t bucket);
+
+struct alignas(64) Slab
+{
+    std::atomic<uint64_t> counters[COUNTERS];
+    std::atomic<uint64_t> peer_counters[PEER_COUNTERS][MAX_PEERS];
+    std::atomic<uint64_t> histogram_sums[HISTOGRAMS];
+    std::atomic<uint64_t> buckets[HISTOGRAMS][HISTOGRAM_BUCKETS];
+    Slab* next;
+
+    Slab();
+    void clear();
+};
+
+// Only the owning thread writes a slab, so load + store is enough.
+inline void bump(std::atomic<uint64_t>& cell, uint64_t n)
+{
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+Slab* attachThread();
+
+inline Slab& local()
+{
+    static thread_local Slab* slab = nullptr;
+    if (slab == nullptr) slab = attachThread();
+    return *slab;
+}
+
+inline void add(Counter counter, uint64_t n = 1)
+{
+    bump(local().counters[static_cast<size_t>(counter)], n);
+}
+
+inline void addPeer(PeerCounter counter, uint32_t peer_index, uint64_t n = 1)
+{
+    if (peer_index >= MAX_PEERS) return;
+    bump(local().peer_counters[static_cast<size_t>(counter)][peer_index], n);
+}
+
+inline void record(Histogram histogram, uint64_t value)
+{
+    Slab& slab = local();
+    size_t h = static_cast<size_t>(histogram);
+    bump(slab.buckets[h][bucketOf(value)], 1);
+    bump(slab.histogram_sums[h], value);
+}
+
+void recordOrigin(OriginHistogram histogram, uint32_t origin_id, uint64_t value);
+
+// Per-thread CPU time and context switches, one "thread <name> ..." line each in the dump.
+// A thread opts in with attachThreadUsage (ThreadScope does); detachThreadUsage, called
+// by the same thread before it exits, freezes its row so joined threads still report.
+// cpu is the CPU the thread was placed on, or NO_CPU (common/threads.hpp); pinned is false
+// if pinning it there failed, which the line reports as "cpu=- pin_failed=<cpu>".
+void attachThreadUsage(const std::string& name, uint32_t cpu, bool pinned = true);
+void detachThreadUsage();
+
+inline uint64_t microsSince(std::chrono::steady_clock::time_point start,
+                            std::chrono::steady_clock::time_point now)
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+    return elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+}
+
+// Sum of one counter over all slabs, for in-process readers (benchmarks waiting on progress).
+uint64_t total(Counter counter);
+
+// Zeroes every slab and origin row and forgets exited threads. Only for benchmarks between
+// runs: counts recorded concurrently may survive or be lost.
+void reset();
+
+// Writes a text snapshot of all slabs to path (via path.tmp + rename, so readers never
+// see a half-written file).
+void dump(const std::string& path);
+
+// Background thread that dumps every interval_ms (0: only the final dump). stopReporter()
+// joins it and writes the final snapshot; both are no-ops if no reporter was started.
+void startReporter(const std::string& path, uint32_t interval_ms);
+void stopReporter();
+
+}
+
+#endif
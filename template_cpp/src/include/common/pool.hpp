@@ -0,0 +1,88 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Allocation-free steady state for the data path.
+//
+// NodePool hands out blocks of a few fixed sizes from slabs and takes them back onto a
+// free list; slabs are only released when the pool is destroyed. It is not thread-safe:
+// each pool belongs to one container and is guarded by the lock that already guards that
+// container (Sender::data_mutex_ for unacked_messages_, ...). Tree nodes are inserted by
+// one thread and erased by another (send thread vs. receive thread handling the ACK), so
+// per-thread free lists would drain on one side and pile up on the other.
+class NodePool
+{
+public:
+    NodePool();
+    ~NodePool();
+
+    void* take(size_t bytes);
+    void give(void* block, size_t bytes);
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+    struct SizeClass
+    {
+        size_t size;
+        FreeBlock* free;
+    };
+
+    // A std::map / std::set needs one size; a std::deque two (blocks and its map array).
+    static constexpr size_t MAX_CLASSES = 4;
+    static constexpr size_t SLAB_BYTES = 16 * 1024;
+
+    SizeClass classes_[MAX_CLASSES];
+    size_t class_count_;
+    std::vector<void*> slabs_;
+
+    SizeClass* classFor(size_t bytes, bool create);
+    void refill(SizeClass& size_class);
+};
+
+// std allocator over a NodePool. Default-constructed (no pool) it is plain operator new,
+// so containers that are never given a pool behave as before.
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept : pool_(nullptr) {}
+    explicit PoolAllocator(NodePool* pool) noexcept : pool_(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept : pool_(other.pool()) {}
+
+    T* allocate(size_t n)
+    {
+        if (pool_ == nullptr) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(pool_->take(n * sizeof(T)));
+    }
+
+    void deallocate(T* block, size_t n) noexcept
+    {
+        if (pool_ == nullptr) ::operator delete(block);
+        else pool_->give(block, n * sizeof(T));
+    }
+
+    NodePool* pool() const noexcept { return pool_; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const noexcept { return pool_ == other.pool(); }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const noexcept { return pool_ != other.pool(); }
+
+private:
+    NodePool* pool_;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PROPOSAL_FILE_HPP
+#define PROPOSAL_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only mmap of a lattice agreement config ("p vs ds" header, then one proposal per line).
+// Nothing is parsed up front: ProposalIterator scans the mapping on demand, so opening a
+// file with 10^6 proposals costs the same as opening one with 10.
+class ProposalFile
+{
+public:
+    explicit ProposalFile(const std::string& path);
+    ~ProposalFile();
+
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+
+    ProposalFile(const ProposalFile&) = delete;
+    ProposalFile& operator=(const ProposalFile&) = delete;
+};
+
+// Forward-only cursor over the proposal lines (the header line is skipped).
+// Lines without any number are skipped, as Config::parse always did.
+// Pages the cursor has left behind are handed back to the kernel every RELEASE_BYTES,
+// so resident memory does not grow with the number of proposals read.
+class ProposalIterator
+{
+public:
+    explicit ProposalIterator(const ProposalFile& file);
+
+    // Fills values with the next proposal; false once the file is exhausted.
+    bool next(std::vector<uint32_t>& values);
+
+private:
+    const char* pos_;
+    const char* end_;
+    const char* released_;  // page-aligned; [mapping start, released_) already dropped
+
+    static constexpr size_t RELEASE_BYTES = 1 << 20;
+
+    void releaseConsumed();
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef RUNTIME_OPTIONS_HPP
+#define RUNTIME_OPTIONS_HPP
+
+#include "common/threads.hpp"
+#include <cstdint>
+
+// FLOOD: every first-seen message is forwarded to all n-1 peers (classic majority-ack URB).
+// TREE:  messages travel along a per-origin k-ary relay tree; delivery uses majority
+//        stability learned from periodic per-origin watermark digests.
+enum class RelayMode 
+{
+    FLOOD,
+    TREE
+};
+
+// LINK_ACK: every relayed copy is tracked by a perfect-link Sender until the peer ACKs it.
+// DIGEST:   relays are sent once; gaps seen in peers' watermark + gap-bitmap digests drive
+//           retransmission, so there are no per-message timers (implies RelayMode::TREE).
+enum class RepairMode 
+{
+    LINK_ACK,
+    DIGEST
+};
+
+// TEXT:   one "b seq" / "d sender seq" line per event, appended in ~4 KiB writes.
+// RANGES: consecutive events of one sender are kept as (sender, first_seq, count) runs in a
+//         binary <output>.ranges file, expanded into the text output at shutdown.
+enum class LogFormat 
+{
+    TEXT,
+    RANGES
+};
+
+// Knobs selected at process startup. The command line is fixed by the project template,
+// so they are read from the environment:
+//   DA_RELAY=flood|tree      relay strategy for FIFO broadcast (default flood)
+//   DA_RELAY_FANOUT=<k>      children per node in TREE mode (default 3)
+//   DA_REPAIR=ack|digest     how relayed copies are made reliable (default ack)
+//   DA_LA_PIPELINE=<k>       lattice agreement shots proposed concurrently (default 32)
+//   DA_METRICS=on|off        write <output>.metrics snapshots (default on)
+//   DA_METRICS_INTERVAL=<ms> snapshot period; 0 = only the final one at shutdown (default 1000)
+//   DA_TRACE=<k>             FIFO broadcast latency tracing of every k-th seq (default 0 = off)
+//   DA_CAPTURE=on|off        record received datagrams to <output>.capture (default off)
+//   DA_LOG=text|ranges       delivery log format for links and FIFO broadcast (default text)
+//   DA_BUSY_POLL=<us>        links and FIFO broadcast: receives spin <us> on non-blocking
+//                            recvfrom (plus SO_BUSY_POLL=<us> where allowed) before blocking;
+//                            the perfect-link Sender also spins <us> before sleeping. Costs a
+//                            core per spinning thread (default 0 = blocking)
+//   DA_BUSY_POLL_CPU=<c>     shorthand for DA_THREADS=recv=<c> (default: not pinned)
+//   DA_THREADS=<spec>        pin protocol threads by role, e.g. recv=0,flush=1,send=2-5,colocate
+//                            (ThreadPlacement in common/threads.hpp; default: none pinned)
+//   DA_PAYLOAD=<bytes>       FIFO broadcast, DA_RELAY=flood: every message carries a body of
+//                            <bytes> (at most MAX_PAYLOAD_BYTES), shared by all links that
+//                            relay it (default 0 = seq numbers only)
+//   DA_GSO=on|off            UDP segmentation offload: Senders' backlogs and retransmission
+//                            bursts go out as one UDP_SEGMENT send, receives take UDP_GRO
+//                            batches; falls back per datagram where unsupported (default on)
+struct RuntimeOptions 
+{
+    RelayMode relay_mode;
+    uint32_t relay_fanout;
+    RepairMode repair_mode;
+    uint32_t lattice_pipeline;
+    bool metrics_enabled;
+    uint32_t metrics_interval_ms;
+    uint32_t trace_sample;
+    bool capture_enabled;
+    LogFormat log_format;
+    uint32_t busy_poll_us;
+    ThreadPlacement thread_placement;
+    uint32_t payload_bytes;
+    bool segmentation_offload;
+
+    static constexpr uint32_t MAX_PAYLOAD_BYTES = 60000;  // one body per datagram, with headroom for the header
+
+    RuntimeOptions() 
+        : relay_mode(RelayMode::FLOOD), relay_fanout(3), repair_mode(RepairMode::LINK_ACK),
+          lattice_pipeline(32), metrics_enabled(true), metrics_interval_ms(1000),
+          trace_sample(0), capture_enabled(false), log_format(LogFormat::TEXT),
+          busy_poll_us(0), payload_bytes(0), segmentation_offload(true) {}
+
+    static RuntimeOptions fromEnv();
+};
+
+#endif
@@ -2,15 +2,29 @@
 #define SIGNAL_HANDLER_HPP
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 
+// SIGTERM/SIGINT set the stop flag and write an eventfd, so the main thread sleeping in
+// waitForStop() wakes at once instead of on its next poll. A second signal gets the default
+// action (the process dies) in case shutdown hangs.
 class SignalHandler {
 public:
     static void setup();
     static bool shouldStop();
+    // Blocks until a stop signal arrived or wake() was called
+    static void waitForStop();
+    // Releases waitForStop() without a signal, e.g. when a sender has all its messages ACKed
+    static void wake();
+    // When the stop signal (or the first wake()) came; now() if neither did yet
+    static std::chrono::steady_clock::time_point stopRequestedAt();
 
 private:
     static std::atomic<bool> stop_flag_;
+    static std::atomic<int64_t> stop_time_ns_;
+    static int event_fd_;
     static void handleSignal(int signal);
+    static void markStopTime();
     
     // Prevent instantiation
     SignalHandler() = delete;
@@ -19,4 +33,4 @@ private:
     SignalHandler& operator=(const SignalHandler&) = delete;
 };
 
-#endif
\ No newline at end of file
+#endif
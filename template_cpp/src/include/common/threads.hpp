@@ -0,0 +1,80 @@
+#ifndef THREADS_HPP
+#define THREADS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Thread placement: names, CPU pinning and per-thread CPU accounting for the protocol
+// threads (RuntimeOptions thread_placement / busy_poll_*).
+
+static constexpr uint32_t NO_CPU = 0xFFFFFFFF;
+static constexpr uint32_t NO_PEER = 0xFFFFFFFF;
+
+// Spin-wait hint: lets the sibling hyperthread run and saves power while polling.
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Pins the calling thread to one CPU. Returns false if the CPU doesn't exist or isn't in
+// the allowed set.
+bool pinCurrentThread(uint32_t cpu);
+
+// What a thread does; per-peer roles (SEND, RETRANSMIT) have one thread per Sender.
+enum class ThreadRole : uint32_t
+{
+    RECEIVE,      // app receiveLoop
+    FLUSH,        // Receiver::flushLoop, standalone ACKs
+    SEND,         // Sender::sendLoop
+    RETRANSMIT,   // Sender::retransmitLoop
+    DIGEST,       // FIFO broadcast digest / repair
+    FLOW,         // lattice agreement flow control
+    COUNT
+};
+
+static constexpr size_t THREAD_ROLES = static_cast<size_t>(ThreadRole::COUNT);
+
+const char* threadRoleName(ThreadRole role);
+
+// Which CPUs each role may run on, parsed from "role=cpus,role=cpus,..." where cpus is
+// "c" or "a-b", role is one of recv|flush|send|retx|digest|flow or "default" (roles
+// without their own entry), plus the flag "colocate". A role given a range puts its
+// k-th thread (the Sender for peer index k, for per-peer roles) on the k-th CPU of the
+// range, round robin. "colocate" puts each peer's retransmit thread on the same CPU as
+// that peer's send thread, so the two threads sharing the Sender's locks and unacked map
+// also share a cache. Roles without CPUs are left to the scheduler.
+struct ThreadPlacement
+{
+    std::vector<uint32_t> cpus[THREAD_ROLES];
+    bool colocate;
+
+    ThreadPlacement() : colocate(false) {}
+
+    // Returns false (leaving out untouched) if spec is malformed.
+    static bool parse(const std::string& spec, ThreadPlacement& out);
+
+    uint32_t cpuFor(ThreadRole role, uint32_t peer_index) const;
+    bool empty() const;
+};
+
+// Lives on the stack of a protocol thread's loop: names the thread "<role>" or
+// "<role>.<peer id>" (visible in top -H / perf), pins it per placement, and registers it
+// for the "thread" lines of the metrics dump, whose CPU time is finalized on destruction.
+class ThreadScope
+{
+public:
+    ThreadScope(const ThreadPlacement& placement, ThreadRole role, uint32_t peer_index = NO_PEER,
+                uint32_t peer_id = 0);
+    ~ThreadScope();
+
+    ThreadScope(const ThreadScope&) = delete;
+    ThreadScope& operator=(const ThreadScope&) = delete;
+};
+
+#endif
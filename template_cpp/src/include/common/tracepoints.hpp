@@ -0,0 +1,62 @@
+#ifndef TRACEPOINTS_HPP
+#define TRACEPOINTS_HPP
+
+// Static (USDT) tracepoints, provider "da_proc". With <sys/sdt.h> available (Debian/Ubuntu:
+// systemtap-sdt-dev) every DA_PROBEn compiles to a single nop plus an ELF note, so a running
+// da_proc can be traced with perf/bpftrace without rebuilding (see tools/bpftrace/). Without
+// the header, or with -DDA_NO_USDT, the macros expand to nothing and the arguments are not
+// evaluated. All arguments are passed as uint64_t.
+//
+//   packet_send(peer_id, origin_id, first_seq, count)   Sender::sendLoop, first transmission
+//   retransmit(peer_id, origin_id, first_seq, count)    Sender::retransmitLoop
+//   ack_receive(peer_id, acked)                          Sender::handleAck
+//   deliver(origin_id, seq) / duplicate(origin_id, seq)  Receiver::handle (logging links)
+//   broadcast(origin_id, seq)                            FIFO broadcast of an own message
+//   fifo_deliver(origin_id, seq)                         FIFO delivery
+//   logger_flush(lines)                                  Logger::flushInternal
+
+#if !defined(DA_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DA_USDT_ENABLED 1
+#endif
+#endif
+
+#ifdef DA_USDT_ENABLED
+
+#include <cstdint>
+
+// sdt.h's argument-size helpers use C-style casts; keep them out of -Werror.
+#define DA_PROBE_BEGIN_ \
+    _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wold-style-cast\"")
+#define DA_PROBE_END_ _Pragma("GCC diagnostic pop")
+
+#define DA_PROBE1(name, a)                                                             \
+    do {                                                                               \
+        DA_PROBE_BEGIN_                                                                \
+        DTRACE_PROBE1(da_proc, name, static_cast<uint64_t>(a));                        \
+        DA_PROBE_END_                                                                  \
+    } while (0)
+#define DA_PROBE2(name, a, b)                                                          \
+    do {                                                                               \
+        DA_PROBE_BEGIN_                                                                \
+        DTRACE_PROBE2(da_proc, name, static_cast<uint64_t>(a), static_cast<uint64_t>(b)); \
+        DA_PROBE_END_                                                                  \
+    } while (0)
+#define DA_PROBE4(name, a, b, c, d)                                                    \
+    do {                                                                               \
+        DA_PROBE_BEGIN_                                                                \
+        DTRACE_PROBE4(da_proc, name, static_cast<uint64_t>(a), static_cast<uint64_t>(b), \
+                      static_cast<uint64_t>(c), static_cast<uint64_t>(d));             \
+        DA_PROBE_END_                                                                  \
+    } while (0)
+
+#else
+
+#define DA_PROBE1(name, a) do { } while (0)
+#define DA_PROBE2(name, a, b) do { } while (0)
+#define DA_PROBE4(name, a, b, c, d) do { } while (0)
+
+#endif
+
+#endif
@@ -18,12 +18,29 @@ struct Host {
 enum class MessageType : uint8_t {
     PERFECT_LINK_DATA = 0x01,
     PERFECT_LINK_ACK  = 0x02,
+    PERFECT_LINK_PAYLOAD = 0x03,
     
     BROADCAST_DATA = 0x11,
     BROADCAST_ACK  = 0x12,
+    BROADCAST_DIGEST = 0x13,
+    BROADCAST_PAYLOAD = 0x14,  // BROADCAST_DATA whose messages carry bodies
     
     PROPOSAL = 0x21,
-    NACK     = 0x22
+    NACK     = 0x22,
+    LATTICE_ACK = 0x23,
+    LATTICE_DECIDED = 0x24
+};
+
+// Latency tracing: when the origin broadcast message seq, in steady_clock microseconds.
+// CLOCK_MONOTONIC is shared by all processes of one host, so this is only meaningful
+// for receivers on the same machine as the origin.
+struct TraceStamp 
+{
+    uint32_t seq;
+    uint64_t broadcast_us;
+    
+    TraceStamp() : seq(0), broadcast_us(0) {}
+    TraceStamp(uint32_t seq, uint64_t broadcast_us) : seq(seq), broadcast_us(broadcast_us) {}
 };
 
 struct PerfectLinkConfig 
@@ -49,7 +66,7 @@ struct LatticeAgreementConfig
     uint32_t proposals;
     uint32_t max_values;
     uint32_t distinct_values;
-    std::vector<std::vector<uint32_t>> proposal_sets;
+    std::string path;  // proposals are read lazily from here (ProposalIterator)
     
     LatticeAgreementConfig() 
         : proposals(0), max_values(0), distinct_values(0) {}
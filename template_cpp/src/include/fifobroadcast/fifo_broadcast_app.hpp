@@ -3,8 +3,15 @@
 
 #include "common/types.hpp"
 #include "common/logger.hpp"
+#include "common/latency_tracer.hpp"
+#include "common/runtime_options.hpp"
 #include "network/udp_socket.hpp"
+#include "network/peer_directory.hpp"
+#include "network/packet_capture.hpp"
 #include "perfectlink/perfect_link_app.hpp"
+#include "fifobroadcast/relay_tree.hpp"
+#include <chrono>
+#include <deque>
 #include <map>
 #include <set>
 #include <mutex>
@@ -23,44 +30,81 @@ struct MessageIdHash {
 
 class FIFOBroadcastApp {
 public:
+    // transport == nullptr binds a UDPSocket on our hosts-file port; otherwise the app owns it.
     FIFOBroadcastApp(uint32_t my_id, const std::vector<Host>& hosts,
-                     uint32_t m, const std::string& output_path);
+                     uint32_t m, const std::string& output_path,
+                     const RuntimeOptions& options = RuntimeOptions(),
+                     Transport* transport = nullptr);
     ~FIFOBroadcastApp();
     
     void run();
     void shutdown();
+    // receiveLoop's body, public so that captures can be replayed without the socket
+    void handleDatagram(const std::vector<uint8_t>& data, const sockaddr_in& sender_addr);
 
 private:
     uint32_t my_id_;
-    std::vector<Host> hosts_;
+    PeerDirectory peers_;
+    uint32_t my_index_;
     uint32_t m_;
     uint32_t n_processes_;
     uint32_t majority_;
+    RuntimeOptions options_;
     
-    std::map<uint32_t, milestone1::Sender*> senders_;
+    std::vector<milestone1::Sender*> senders_;  // indexed by peer index, nullptr for self
     milestone1::Receiver* receiver_;
-    UDPSocket* receiver_socket_;
-    UDPSocket* sender_socket_;
+    Transport* socket_;  // owned; a UDPSocket unless one was passed in
     Logger* logger_;
+    LatencyTracer* tracer_;  // nullptr unless DA_TRACE is set
+    PacketCaptureWriter* capture_;  // nullptr unless DA_CAPTURE=on
     
     std::set<MessageId> forwarded_;
     std::map<MessageId, std::set<uint32_t>> urb_ack_list_;
     std::set<MessageId> urb_delivered_;
     
     std::map<uint32_t, uint32_t> next_;
-    std::map<uint32_t, std::map<uint32_t, MessageId>> pending_;
+    // origin -> seq -> when it was URB-delivered, held back until the FIFO gap closes
+    std::map<uint32_t, std::map<uint32_t, std::chrono::steady_clock::time_point>> pending_;
+    
+    // TREE relay mode. Per-origin state is indexed by origin peer index.
+    RelayTree relay_tree_;
+    std::vector<uint32_t> have_;                     // contiguous received watermark
+    std::vector<std::set<uint32_t>> have_above_;     // received beyond the watermark
+    std::vector<std::vector<uint32_t>> peer_have_;   // [peer][origin] from digests
+    std::vector<std::vector<uint64_t>> peer_gaps_;   // [peer][origin] received_above from digests
+    std::vector<std::vector<uint32_t>> repaired_;    // LINK_ACK repair: [peer][origin] pushed up to
+    std::vector<std::vector<std::chrono::steady_clock::time_point>> last_repair_;  // DIGEST repair
+    std::deque<std::pair<std::chrono::steady_clock::time_point, std::vector<uint32_t>>> have_history_;
+    std::thread digest_thread_;
     
     std::mutex receiver_state_mutex_;
     std::thread receive_thread_;
     std::atomic<bool> running_;
     
+    static constexpr std::chrono::milliseconds DIGEST_INTERVAL{10};
+    static constexpr std::chrono::milliseconds SUSPECT_TIMEOUT{200};
+    static constexpr std::chrono::milliseconds REPAIR_INTERVAL{30};
+    static constexpr uint32_t REPAIR_BUDGET = 256;  // messages per (peer, origin) per digest round
+    static constexpr uint32_t RELAY_BATCH = 16;
+    
     void receiveLoop();
-    void handlePacket(const Packet& packet, const std::string& sender_ip, uint16_t sender_port);
-    void urbBroadcast(uint32_t sender_id, uint32_t seq);
+    void handlePacket(const Packet& packet, uint32_t peer_index);
+    // payload: the message body (DA_PAYLOAD), handed by reference to every Sender
+    void urbBroadcast(uint32_t sender_id, uint32_t seq, const SharedPayload& payload);
     void fifoDeliver(uint32_t sender_id, uint32_t seq);
     
-    Host findHost(uint32_t id) const;
-    uint32_t getProcessIdFromAddress(const std::string& ip, uint16_t port) const;
+    void treeBroadcast(uint32_t first_seq, uint32_t last_seq);
+    void handleTreePacket(const Packet& packet, uint32_t peer_index);
+    void handleDigest(const Packet& packet, uint32_t peer_index);
+    void relay(uint32_t peer_index, uint32_t origin_id, const std::vector<uint32_t>& seqs);
+    bool markReceived(uint32_t origin_index, uint32_t seq);
+    void deliverStable(uint32_t origin_index);
+    DigestEntry digestEntry(uint32_t origin_index) const;
+    const std::vector<uint32_t>* agedHave(std::chrono::steady_clock::time_point now,
+                                          std::chrono::milliseconds age) const;
+    void collectGaps(uint32_t peer_index, uint32_t origin_index, uint32_t limit,
+                     std::vector<uint32_t>& out) const;
+    void digestLoop();
 };
 
 }
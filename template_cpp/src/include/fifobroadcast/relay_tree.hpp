@@ -0,0 +1,26 @@
+#ifndef RELAY_TREE_HPP
+#define RELAY_TREE_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace milestone2 {
+
+// Deterministic k-ary relay trees, one per origin. Peers are ranked by their distance from
+// the origin on the peer-index ring (origin = rank 0); rank r forwards to ranks k*r+1 .. k*r+k.
+// Every process computes the same trees, so no coordination is needed and each message
+// costs n-1 link transmissions instead of ~n^2.
+class RelayTree {
+public:
+    RelayTree(uint32_t n, uint32_t my_index, uint32_t fanout);
+
+    // Peer indices this process forwards a message from origin_index to.
+    const std::vector<uint32_t>& children(uint32_t origin_index) const { return children_[origin_index]; }
+
+private:
+    std::vector<std::vector<uint32_t>> children_;  // indexed by origin index
+};
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef LATTICE_AGREEMENT_APP_HPP
+#define LATTICE_AGREEMENT_APP_HPP
+
+#include "common/types.hpp"
+#include "common/logger.hpp"
+#include "common/runtime_options.hpp"
+#include "common/proposal_file.hpp"
+#include "network/udp_socket.hpp"
+#include "network/message.hpp"
+#include "network/peer_directory.hpp"
+#include "perfectlink/perfect_link_app.hpp"
+#include "lattice/value_set.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+namespace milestone3 {
+
+// Multi-shot lattice agreement: one independent single-shot instance per config line
+// (proposer + acceptor as in Faleiro et al.), over perfect links carrying LatticeMessages.
+// Up to options.lattice_pipeline own shots are in flight at once; decisions are logged
+// strictly in shot order.
+//
+// Garbage collection: every process announces how far it has decided (LATTICE_DECIDED).
+// Once every process has decided shot s, nobody will propose for it again, so acceptor
+// state below the minimum announced watermark is dropped in bulk. A crashed process stops
+// announcing, so collection stalls at its last watermark (correct processes cannot tell
+// it from a slow one whose proposals still need that state).
+//
+// Flow control keeps that state bounded while everyone is alive: a process starts no shot
+// more than MAX_LEAD beyond the slowest watermark among peers that made progress within
+// SUSPECT_TIMEOUT. Peers silent for longer stop holding the others back (but still hold
+// back collection), so a crash costs memory, never liveness.
+class LatticeAgreementApp {
+public:
+    LatticeAgreementApp(uint32_t my_id, const std::vector<Host>& hosts,
+                        const LatticeAgreementConfig& config, const std::string& output_path,
+                        const RuntimeOptions& options = RuntimeOptions());
+    ~LatticeAgreementApp();
+
+    void run();
+    void shutdown();
+
+private:
+    struct ProposerShot {
+        bool active;
+        uint32_t proposal_number;
+        ValueSet proposed;
+        ValueSet sent;  // proposed as of the last PROPOSAL: the base for the next delta
+        uint32_t ack_count;
+        uint32_t nack_count;
+        std::vector<bool> responded;  // indexed by peer index, for the current proposal_number
+        std::chrono::steady_clock::time_point started;
+    };
+
+    // An acceptor's copy of one proposer's current proposal, rebuilt from PROPOSAL deltas.
+    // Deltas must be applied in proposal_number order; ones that overtake a gap wait in early.
+    struct ProposerView {
+        uint32_t proposal_number;
+        ValueSet values;
+        std::map<uint32_t, std::vector<uint32_t>> early;
+    };
+
+    struct AcceptorShot {
+        ValueSet accepted;
+        std::vector<ProposerView> views;  // indexed by peer index
+    };
+
+    uint32_t my_id_;
+    PeerDirectory peers_;
+    uint32_t my_index_;
+    uint32_t n_processes_;
+    uint32_t majority_;
+    LatticeAgreementConfig config_;
+    ProposalFile proposal_file_;
+    ProposalIterator proposal_iter_;   // shots start in order, so proposals are read in order
+    std::vector<uint32_t> proposal_buffer_;
+    uint32_t shots_;
+    RuntimeOptions options_;
+    ValueUniverse universe_;
+
+    std::vector<milestone1::Sender*> senders_;  // indexed by peer index, nullptr for self
+    milestone1::Receiver* receiver_;
+    UDPSocket* socket_;
+    Logger* logger_;
+
+    std::map<uint32_t, ProposerShot> proposing_;  // own shots started but not decided
+    std::map<uint32_t, AcceptorShot> acceptors_;  // acceptor state per shot >= gc_floor_
+    std::map<uint32_t, ValueSet> decided_;        // decided, waiting for lower shots to be logged
+    uint32_t next_shot_;                          // next own shot to start
+    uint32_t next_logged_;                        // next shot to log == own decided-through
+    std::vector<uint32_t> decided_through_;       // [peer] latest LATTICE_DECIDED watermark
+    std::vector<std::chrono::steady_clock::time_point> progressed_;  // [peer] when it last advanced
+    uint32_t announced_;                          // own watermark last sent to peers
+    uint32_t gc_floor_;                           // shots below this are forgotten
+    std::deque<LatticeMessage> loopback_;         // messages to ourselves, handled after the current one
+    std::vector<std::vector<LatticeMessage>> outbox_;  // per peer, batched into payloads by flushOutbox
+    // Link-level dedupe per peer: every payload seq <= watermark, plus those in above, was handled.
+    // Reprocessing a retransmitted PROPOSAL would queue yet another reliable reply.
+    std::vector<uint32_t> link_watermark_;
+    std::vector<std::set<uint32_t>> link_above_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    std::mutex state_mutex_;
+    std::thread receive_thread_;
+    std::thread flow_thread_;  // re-checks the lead limit while nothing else wakes us
+    std::condition_variable flow_cv_;
+    std::atomic<bool> running_;
+
+    static constexpr size_t MAX_BATCH_BYTES = 4096;
+    static constexpr uint32_t GC_ANNOUNCE_STEP = 256;  // shots between LATTICE_DECIDED announcements
+    static constexpr uint32_t MAX_LEAD = 4096;          // shots beyond the slowest live watermark
+    static constexpr std::chrono::milliseconds SUSPECT_TIMEOUT{1000};
+    static constexpr std::chrono::milliseconds FLOW_CHECK_INTERVAL{100};
+
+    void receiveLoop();
+    void flowLoop();
+    bool firstDelivery(uint32_t peer_index, uint32_t link_seq);
+    // All of the following are called with state_mutex_ held.
+    void startShots();
+    uint32_t leadLimit(std::chrono::steady_clock::time_point now) const;
+    void startShot(uint32_t shot);
+    void propose(uint32_t shot, ProposerShot& state);
+    void sendTo(uint32_t peer_index, const LatticeMessage& message);
+    void handleMessage(uint32_t peer_index, const LatticeMessage& message);
+    void handleProposal(uint32_t peer_index, const LatticeMessage& message);
+    void handleResponse(uint32_t peer_index, const LatticeMessage& message);
+    void decide(uint32_t shot, ProposerShot& state);
+    void announceDecided();
+    void collectGarbage();
+    void drainLoopback();
+    void flushOutbox();
+};
+
+}
+
+#endif
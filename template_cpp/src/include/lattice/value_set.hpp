@@ -0,0 +1,86 @@
+#ifndef VALUE_SET_HPP
+#define VALUE_SET_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace milestone3 {
+
+// Set of proposal values with the two operations lattice agreement spends its time in:
+// union and subset test. DENSE stores a bitset over dictionary ids (see ValueUniverse),
+// SPARSE a sorted vector of raw values. All sets that meet must have the same kind.
+class ValueSet {
+public:
+    enum class Kind : uint8_t {
+        DENSE,
+        SPARSE
+    };
+
+    explicit ValueSet(Kind kind = Kind::SPARSE, size_t words = 0);
+
+    Kind kind() const { return kind_; }
+    bool empty() const;
+    size_t size() const;
+
+    // key is a dictionary id for DENSE sets and the value itself for SPARSE ones
+    bool insert(uint32_t key);
+    bool contains(uint32_t key) const;
+    // Returns true if *this grew.
+    bool unionWith(const ValueSet& other);
+    // other ⊆ *this
+    bool includes(const ValueSet& other) const;
+    // *this \ other
+    ValueSet minus(const ValueSet& other) const;
+
+    template <typename F>
+    void forEachKey(F f) const {
+        if (kind_ == Kind::SPARSE) {
+            for (uint32_t key : sorted_) f(key);
+            return;
+        }
+        for (size_t w = 0; w < words_.size(); w++) {
+            for (uint64_t bits = words_[w]; bits != 0; bits &= bits - 1) {
+                f(static_cast<uint32_t>(w * 64 + static_cast<size_t>(__builtin_ctzll(bits))));
+            }
+        }
+    }
+
+private:
+    Kind kind_;
+    std::vector<uint64_t> words_;   // DENSE
+    std::vector<uint32_t> sorted_;  // SPARSE
+};
+
+// Chooses the representation from the config's distinct_values bound and, for DENSE,
+// interns values into ids 0..ds-1 in first-seen order. Values are arbitrary uint32 and
+// every process sees them in a different order, so ids are local and never go on the wire.
+class ValueUniverse {
+public:
+    ValueUniverse(uint32_t distinct_values, uint32_t max_values);
+
+    ValueSet::Kind kind() const { return kind_; }
+    ValueSet emptySet() const { return ValueSet(kind_, words_); }
+
+    ValueSet fromValues(const std::vector<uint32_t>& values);
+    void insertValues(ValueSet& set, const std::vector<uint32_t>& values);
+    std::vector<uint32_t> toValues(const ValueSet& set) const;
+
+    // dense iff the bitset is no bigger than a max-size proposal as a sorted vector,
+    // or fits in a few words anyway
+    static constexpr uint32_t SMALL_UNIVERSE = 256;
+    static constexpr uint32_t MAX_DENSE_UNIVERSE = 1u << 20;
+
+private:
+    ValueSet::Kind kind_;
+    size_t words_;
+    std::unordered_map<uint32_t, uint32_t> ids_;
+    std::vector<uint32_t> values_;  // id -> value
+
+    uint32_t keyOf(uint32_t value);
+};
+
+}
+
+#endif
@@ -2,9 +2,16 @@
 #define MESSAGE_HPP
 
 #include "common/types.hpp"
+#include <sys/uio.h>
+#include <memory>
 #include <vector>
 #include <cstdint>
 
+// Immutable message body, shared by everything that may still send it (the unacked entries
+// of all n-1 broadcast Senders, their retransmissions): stored once per process and freed
+// with the last reference. Nothing may modify the bytes once it is shared.
+using SharedPayload = std::shared_ptr<const std::vector<uint8_t>>;
+
 struct Message 
 {
     uint32_t sender_id;
@@ -15,19 +22,114 @@ struct Message
         : sender_id(sender), seq_number(seq) {}
 };
 
+// Per-origin anti-entropy summary carried by BROADCAST_DIGEST: everything up to watermark
+// has been received, and bit i of received_above is set if watermark + 1 + i has been too.
+struct DigestEntry 
+{
+    uint32_t origin;
+    uint32_t watermark;
+    uint64_t received_above;
+    
+    static constexpr uint32_t GAP_BITS = 64;
+};
+
+// Lattice agreement message. Several of them (for different shots) travel in one perfect-link
+// payload. values are deltas: a PROPOSAL carries what was added since the same proposer's
+// previous proposal_number for that shot, a NACK what the acceptor has beyond that proposal.
+// LATTICE_ACK carries no values. LATTICE_DECIDED (no values either) announces in shot
+// that the sender has decided every shot below it.
+struct LatticeMessage 
+{
+    MessageType kind;
+    uint32_t shot;
+    uint32_t proposal_number;
+    std::vector<uint32_t> values;
+    
+    LatticeMessage() : kind(MessageType::PROPOSAL), shot(0), proposal_number(0) {}
+    
+    bool hasValues() const { return kind == MessageType::PROPOSAL || kind == MessageType::NACK; }
+    
+    // Sorts messages by shot and packs them into payloads of about max_bytes each.
+    static std::vector<std::vector<uint8_t>> serializeBatch(std::vector<LatticeMessage>& messages,
+                                                            size_t max_bytes);
+    static std::vector<LatticeMessage> deserializeBatch(const std::vector<uint8_t>& data);
+};
+
 // Packet that contains multiple messages (up to 8),type: DATA or ACK
+// Broadcast mode uses BROADCAST_DATA / BROADCAST_ACK: ACKs name (origin, seq) because one link
+// carries messages from every origin, and BROADCAST_DATA piggybacks ACKs for the reverse direction.
+// PERFECT_LINK_PAYLOAD / BROADCAST_PAYLOAD are the DATA variants with a body per seq; the
+// bodies come last on the wire, after a header that holds their lengths, so that a sender
+// can hand them to the socket where they are (serializeHeader + sendGather) without copying.
 struct Packet 
 {
     // type区分DATA和ACK包，sender_id只在DATA包中使用，对于vector<uint32_t> seq_numbers可以一次发送多个数据的序号或者ACK的序号
     MessageType type;
     uint32_t sender_id;  // only for DATA packets
     std::vector<uint32_t> seq_numbers;  // message seq numbers or ACK seq numbers
+    std::vector<Message> acks;          // only for BROADCAST_DATA / BROADCAST_ACK
+    std::vector<DigestEntry> digest;    // only for BROADCAST_DIGEST
+    std::vector<SharedPayload> payloads;  // only for *_PAYLOAD, one per seq
+    std::vector<TraceStamp> stamps;     // only for BROADCAST_DATA / _PAYLOAD: sampled seqs' broadcast times
     // 自动初始化Packet
     Packet() : type(MessageType::PERFECT_LINK_DATA), sender_id(0) {}
     
     std::vector<uint8_t> serialize() const;
     static Packet deserialize(const std::vector<uint8_t>& data);
+    // Hot-path variants that reuse the caller's storage: serializeInto replaces buffer's
+    // contents, deserializeInto overwrites every field of packet. Once the vectors have
+    // grown to a packet's size neither allocates.
+    void serializeInto(std::vector<uint8_t>& buffer) const;
+    static void deserializeInto(const std::vector<uint8_t>& data, Packet& packet);
+    // serializeInto without the payload bodies: the datagram is buffer followed by each
+    // payload's bytes in order.
+    void serializeHeader(std::vector<uint8_t>& buffer) const;
+    bool hasPayloads() const 
+    {
+        return type == MessageType::PERFECT_LINK_PAYLOAD || type == MessageType::BROADCAST_PAYLOAD;
+    }
     static Packet createDataPacket(uint32_t sender_id, const std::vector<uint32_t>& seq_numbers);
+    static Packet createPayloadPacket(uint32_t sender_id, const std::vector<uint32_t>& seq_numbers,
+                                      const std::vector<SharedPayload>& payloads);
     static Packet createAckPacket(const std::vector<uint32_t>& seq_numbers);
+    static Packet createBroadcastAckPacket(const std::vector<Message>& acks);
+    static Packet createDigestPacket(const std::vector<DigestEntry>& digest);
+
+    // Seqs, acks, stamps and digest entries are each counted by one byte on the wire;
+    // whoever fills a Packet must stay within this.
+    static constexpr size_t MAX_ENTRIES = 255;
+};
+
+// A Packet and its encoding, owned by one sending thread and reused for everything it
+// sends: once the vectors have grown to a packet's size, filling and encoding allocate
+// nothing. Starts out with room for a typical packet.
+struct OutgoingPacket 
+{
+    Packet packet;
+    std::vector<uint8_t> bytes;
+    std::vector<iovec> parts;
+
+    OutgoingPacket();
+    const std::vector<uint8_t>& encode() 
+    {
+        packet.serializeInto(bytes);
+        return bytes;
+    }
+    // Header in bytes, then one part per payload pointing at the shared body itself.
+    // Valid while packet (which holds the references) is unchanged.
+    const std::vector<iovec>& gather();
+
+    // Encoded datagrams back to back, with their sizes, for one Transport::sendSegmented
+    std::vector<uint8_t> burst;
+    std::vector<size_t> burst_sizes;
+    void appendToBurst() 
+    {
+        packet.serializeInto(bytes);
+        burst.insert(burst.end(), bytes.begin(), bytes.end());
+        burst_sizes.push_back(bytes.size());
+    }
+
+    static constexpr size_t RESERVED_BYTES = 1472;  // UDP payload of a 1500-byte Ethernet frame
+    static constexpr size_t RESERVED_ENTRIES = 32;
 };
 #endif
\ No newline at end of file
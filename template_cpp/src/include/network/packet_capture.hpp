@@ -0,0 +1,60 @@
+#ifndef PACKET_CAPTURE_HPP
+#define PACKET_CAPTURE_HPP
+
+#include "common/types.hpp"
+#include "network/peer_directory.hpp"
+#include <netinet/in.h>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Raw receive-path capture (DA_CAPTURE=on -> <output>.capture), replayed in-process by
+// test_scripts/common/replay_capture.cpp.
+//
+// File layout, big-endian like the wire format:
+//   header  "DACAP001" | my_id u32 | n u32 | n x (id u32, ipv4 u32, port u16)
+//   record  t_us u64 (since capture start) | source ipv4 u32 | source port u16
+//           | length u16 | datagram bytes
+// The peer list makes a capture self-contained: replay rebuilds the same PeerDirectory.
+struct CapturedDatagram
+{
+    uint64_t t_us;
+    sockaddr_in source;
+    std::vector<uint8_t> data;
+};
+
+// Written by the receive thread only, so no locking. Records are buffered and written in
+// BUFFER_BYTES chunks; close() (or the destructor) writes the tail.
+class PacketCaptureWriter
+{
+public:
+    PacketCaptureWriter(const std::string& path, uint32_t my_id, const PeerDirectory& peers);
+    ~PacketCaptureWriter();
+
+    void record(const sockaddr_in& source, const std::vector<uint8_t>& data);
+    void close();
+
+private:
+    std::ofstream out_;
+    std::vector<uint8_t> buffer_;
+    std::chrono::steady_clock::time_point start_;
+
+    static constexpr size_t BUFFER_BYTES = 1 << 20;
+
+    void writeBuffer();
+};
+
+struct PacketCapture
+{
+    uint32_t my_id = 0;
+    std::vector<Host> hosts;
+    std::vector<CapturedDatagram> datagrams;
+
+    // Whole file into memory, so replay timing excludes I/O. Throws on a malformed file;
+    // a record cut short (process killed mid-write) ends the capture.
+    static PacketCapture load(const std::string& path);
+};
+
+#endif
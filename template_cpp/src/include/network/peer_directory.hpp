@@ -0,0 +1,69 @@
+#ifndef PEER_DIRECTORY_HPP
+#define PEER_DIRECTORY_HPP
+
+#include "common/types.hpp"
+#include <netinet/in.h>
+#include <cstdint>
+#include <vector>
+
+// One entry per host in the hosts file. index is dense (0..n-1, hosts file order)
+// so every subsystem can keep per-peer state in plain vectors.
+struct Peer
+{
+    uint32_t id;
+    uint32_t index;
+    Host host;
+    sockaddr_in addr;
+};
+
+// Built once at startup from the hosts file. Translates process ids and
+// (IPv4, port) source addresses to dense peer indices without scanning the host list:
+// ids go through a direct-indexed table, addresses through a collision-free
+// multiplicative hash found at construction time.
+class PeerDirectory
+{
+public:
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+    explicit PeerDirectory(const std::vector<Host>& hosts);
+
+    size_t size() const { return peers_.size(); }
+    const Peer& at(uint32_t index) const { return peers_[index]; }
+    const std::vector<Peer>& peers() const { return peers_; }
+
+    uint32_t indexOfId(uint32_t id) const
+    {
+        return id < id_to_index_.size() ? id_to_index_[id] : INVALID_INDEX;
+    }
+
+    uint32_t lookup(const sockaddr_in& addr) const
+    {
+        uint64_t key = makeKey(addr.sin_addr.s_addr, addr.sin_port);
+        size_t slot = slotOf(key);
+        return slot_keys_[slot] == key ? slot_index_[slot] : INVALID_INDEX;
+    }
+
+private:
+    std::vector<Peer> peers_;
+    std::vector<uint32_t> id_to_index_;
+    std::vector<uint64_t> slot_keys_;
+    std::vector<uint32_t> slot_index_;
+    uint64_t multiplier_;
+    unsigned shift_;
+
+    // Both halves are kept in network byte order, exactly as they arrive in sockaddr_in.
+    // The top bit marks a used slot so an all-zero address can never match an empty one.
+    static uint64_t makeKey(in_addr_t ip, in_port_t port)
+    {
+        return (1ull << 63) | (static_cast<uint64_t>(ip) << 16) | port;
+    }
+
+    size_t slotOf(uint64_t key) const
+    {
+        return static_cast<size_t>((key * multiplier_) >> shift_);
+    }
+
+    bool buildTable(const std::vector<std::pair<uint64_t, uint32_t>>& keys, unsigned bits, uint64_t multiplier);
+};
+
+#endif
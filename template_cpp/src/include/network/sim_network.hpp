@@ -0,0 +1,113 @@
+#ifndef SIM_NETWORK_HPP
+#define SIM_NETWORK_HPP
+
+#include "network/transport.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// In-process datagram network for benchmarks: n apps in one process, each on a SimSocket,
+// with loss / delay / jitter / reordering / duplication applied per datagram. No root, no
+// ports, no tc. Time is the real steady_clock (every protocol timer waits on it), so a seed
+// fixes each sender's sequence of network decisions but not the thread interleaving.
+struct NetworkProfile
+{
+    std::string name;
+    double loss;                           // P(datagram dropped)
+    double duplicate;                      // P(one extra copy, with its own delay)
+    double reorder;                        // P(reorder_delay added on top)
+    std::chrono::microseconds delay;
+    std::chrono::microseconds jitter;      // uniform in [0, jitter)
+    std::chrono::microseconds reorder_delay;
+
+    // ideal, lan, lossy, and tc (the netem settings tools/tc.py applies)
+    static const std::vector<NetworkProfile>& presets();
+    static const NetworkProfile* byName(const std::string& name);
+};
+
+class SimNetwork;
+
+class SimSocket : public Transport
+{
+public:
+    ~SimSocket() override;
+
+    void send(const sockaddr_in& dest, const std::vector<uint8_t>& data) override;
+    size_t receive(std::vector<uint8_t>& buffer, sockaddr_in& sender_addr) override;
+    void close() override;
+
+private:
+    friend class SimNetwork;
+
+    struct InFlight
+    {
+        sockaddr_in from;
+        std::vector<uint8_t> data;
+    };
+    // (due, arrival order): equal due times come out in send order
+    using InboxKey = std::pair<std::chrono::steady_clock::time_point, uint64_t>;
+
+    SimSocket(SimNetwork* network, const sockaddr_in& addr, uint64_t seed);
+    void enqueue(std::chrono::steady_clock::time_point due, const sockaddr_in& from,
+                 const std::vector<uint8_t>& data);
+
+    SimNetwork* network_;
+    sockaddr_in addr_;
+
+    std::mutex rng_mutex_;  // send side: this socket's draws
+    std::mt19937_64 rng_;
+
+    std::mutex mtx_;        // receive side
+    std::condition_variable cv_;
+    std::map<InboxKey, InFlight> inbox_;
+    uint64_t arrivals_;
+    bool closed_;
+
+    SimSocket(const SimSocket&) = delete;
+    SimSocket& operator=(const SimSocket&) = delete;
+};
+
+class SimNetwork
+{
+public:
+    struct Stats
+    {
+        uint64_t sent;
+        uint64_t dropped;
+        uint64_t duplicated;
+        uint64_t unroutable;  // no socket at the destination (closed or never attached)
+    };
+
+    SimNetwork(const NetworkProfile& profile, uint64_t seed);
+
+    // The endpoint at ip:port, as written in the hosts file. Pass it to an app, which owns
+    // it; the network must outlive every socket attached to it.
+    SimSocket* attach(const std::string& ip, uint16_t port);
+    Stats stats() const;
+    const NetworkProfile& profile() const { return profile_; }
+
+private:
+    friend class SimSocket;
+
+    NetworkProfile profile_;
+    uint64_t seed_;
+
+    mutable std::mutex mtx_;  // endpoints_; taken before any SimSocket::mtx_
+    std::map<uint64_t, SimSocket*> endpoints_;
+
+    std::atomic<uint64_t> sent_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> duplicated_;
+    std::atomic<uint64_t> unroutable_;
+
+    void route(SimSocket& from, const sockaddr_in& dest, const std::vector<uint8_t>& data);
+    void detach(SimSocket* socket);
+};
+
+#endif
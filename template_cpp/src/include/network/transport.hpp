@@ -0,0 +1,50 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <netinet/in.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What the protocol layers need from a datagram endpoint. UDPSocket is the real one;
+// SimSocket (network/sim_network.hpp) runs many processes in one address space.
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    // Unreliable, returns immediately.
+    virtual void send(const sockaddr_in& dest, const std::vector<uint8_t>& data) = 0;
+    // One datagram made of parts back to back. This default joins them and calls send();
+    // UDPSocket hands them to sendmsg as they are.
+    virtual void sendGather(const sockaddr_in& dest, const std::vector<iovec>& parts)
+    {
+        std::vector<uint8_t> data;
+        for (const iovec& part : parts) 
+        {
+            const uint8_t* begin = static_cast<const uint8_t*>(part.iov_base);
+            data.insert(data.end(), begin, begin + part.iov_len);
+        }
+        send(dest, data);
+    }
+    // Datagrams of segment_size bytes back to back (the last one may be shorter), at most
+    // MAX_SEGMENTS of them and MAX_SEGMENTED_BYTES in all. This default sends them one by
+    // one; UDPSocket hands the whole buffer to the kernel once (UDP GSO) where it can.
+    virtual void sendSegmented(const sockaddr_in& dest, const uint8_t* data, size_t length, size_t segment_size)
+    {
+        for (size_t offset = 0; offset < length; offset += segment_size) 
+        {
+            send(dest, std::vector<uint8_t>(data + offset, data + std::min(length, offset + segment_size)));
+        }
+    }
+
+    static constexpr size_t MAX_SEGMENTS = 64;             // UDP_MAX_SEGMENTS of older kernels
+    static constexpr size_t MAX_SEGMENTED_BYTES = 65000;   // one IP datagram's worth
+    // Blocks for the next datagram; throws std::runtime_error once close() has been called.
+    virtual size_t receive(std::vector<uint8_t>& buffer, sockaddr_in& sender_addr) = 0;
+    virtual void close() = 0;
+};
+
+#endif
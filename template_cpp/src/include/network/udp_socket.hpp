@@ -1,18 +1,43 @@
 #ifndef UDP_SOCKET_HPP
 #define UDP_SOCKET_HPP
 
+#include "network/transport.hpp"
+#include <netinet/in.h>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <string>
+#include <tuple>
 #include <vector>
 
-class UDPSocket {
+class UDPSocket : public Transport {
 public:
     explicit UDPSocket(uint16_t port);
-    ~UDPSocket();
+    ~UDPSocket() override;
     
     void send(const std::string& ip, uint16_t port, const std::vector<uint8_t>& data);
     std::tuple<std::vector<uint8_t>, std::string, uint16_t> receive();
-    void close();
+
+    // Hot-path variants: destination is a precomputed PeerDirectory address, and
+    // receive fills a caller-owned buffer and returns the raw source address.
+    void send(const sockaddr_in& dest, const std::vector<uint8_t>& data) override;
+    size_t receive(std::vector<uint8_t>& buffer, sockaddr_in& sender_addr) override;
+    void sendGather(const sockaddr_in& dest, const std::vector<iovec>& parts) override;
+    void sendSegmented(const sockaddr_in& dest, const uint8_t* data, size_t length, size_t segment_size) override;
+    // Wakes a receive() blocked in another thread (which then throws); the descriptor itself
+    // is released by the destructor, once no thread can still be using it.
+    void close() override;
+    // Busy-poll mode: receive() spins on non-blocking recvfrom for up to <us> before it
+    // sleeps in the kernel, and SO_BUSY_POLL asks the driver to poll for <us> as well (where
+    // supported and permitted; raising it past net.core.busy_read needs CAP_NET_ADMIN).
+    // 0 = always block.
+    void setBusyPoll(uint32_t us);
+    // Segmentation offload: sendSegmented passes its buffer to one sendmsg with UDP_SEGMENT
+    // (GSO), and receive() asks for UDP_GRO, so that a peer's segmented burst can arrive as
+    // one coalesced buffer that receive() then hands out datagram by datagram. Either half
+    // that the kernel refuses (here, or on the first send) falls back to one datagram per
+    // syscall. Call before the socket is shared between threads.
+    void setSegmentationOffload(bool enabled);
     
     uint16_t getPort() const { return port_; }
     int getFd() const { return socket_fd_; }
@@ -20,6 +45,18 @@ public:
 private:
     int socket_fd_;
     uint16_t port_;
+    std::atomic<bool> closed_;
+    std::chrono::microseconds busy_poll_;
+    std::atomic<bool> gso_;
+    bool gro_;
+    // receive() with GRO: the last coalesced buffer, its segment size and source, and how
+    // much of it has been handed out
+    std::vector<uint8_t> gro_batch_;
+    size_t gro_segment_;
+    size_t gro_offset_;
+    sockaddr_in gro_source_;
+    
+    ssize_t receiveOnce(std::vector<uint8_t>& buffer, sockaddr_in& sender_addr, int flags, size_t& segment);
     
     UDPSocket(const UDPSocket&) = delete;
     UDPSocket& operator=(const UDPSocket&) = delete;
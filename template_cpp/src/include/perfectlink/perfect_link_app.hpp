@@ -3,11 +3,20 @@
 
 #include "common/types.hpp"
 #include "common/logger.hpp"
+#include "common/latency_tracer.hpp"
+#include "common/pool.hpp"
+#include "common/runtime_options.hpp"
+#include "common/threads.hpp"
 #include "network/udp_socket.hpp"
+#include "network/transport.hpp"
 #include "network/message.hpp"
+#include "network/peer_directory.hpp"
+#include "network/packet_capture.hpp"
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <deque>
+#include <vector>
 #include <queue>
 #include <map>
 #include <set>
@@ -19,18 +28,33 @@ namespace milestone1
 
 struct SentMessage 
 {
+    uint32_t sender_id;
     uint32_t seq_number;
     std::chrono::steady_clock::time_point last_sent;
     uint32_t retransmit_count;
+    SharedPayload payload;  // nullptr for seq-only messages
     
-    SentMessage() : seq_number(0), retransmit_count(0) {}
-    SentMessage(uint32_t seq, std::chrono::steady_clock::time_point time)
-        : seq_number(seq), last_sent(time), retransmit_count(0) {}
+    SentMessage() : sender_id(0), seq_number(0), retransmit_count(0) {}
+    SentMessage(uint32_t sender, uint32_t seq, std::chrono::steady_clock::time_point time, SharedPayload body)
+        : sender_id(sender), seq_number(seq), last_sent(time), retransmit_count(0), payload(std::move(body)) {}
+};
+
+// A message waiting in Sender::pending_queue_ or picked for (re)transmission
+struct PendingMessage 
+{
+    uint32_t sender_id;
+    uint32_t seq_number;
+    SharedPayload payload;
+    
+    bool operator<(const PendingMessage& other) const {
+        return sender_id != other.sender_id ? sender_id < other.sender_id : seq_number < other.seq_number;
+    }
 };
 
 struct TimeoutEntry 
 {
     std::chrono::steady_clock::time_point timeout_time;
+    uint32_t sender_id;
     uint32_t seq_number;
     
     bool operator>(const TimeoutEntry& other) const {
@@ -38,72 +62,184 @@ struct TimeoutEntry
     }
 };
 
+// Min-heap of TimeoutEntry, earliest timeout on top. Hand-rolled with size_t indices:
+// std::priority_queue's sift loops use signed ptrdiff_t arithmetic, which GCC's
+// -Wstrict-overflow=5 turns into an error in optimized builds.
+class TimeoutHeap 
+{
+public:
+    bool empty() const { return entries_.empty(); }
+    const TimeoutEntry& top() const { return entries_.front(); }
+
+    void push(const TimeoutEntry& entry) 
+    {
+        size_t hole = entries_.size();
+        entries_.push_back(entry);
+        while (hole > 0) 
+        {
+            size_t parent = (hole - 1) / 2;
+            if (!(entries_[parent] > entry)) break;
+            entries_[hole] = entries_[parent];
+            hole = parent;
+        }
+        entries_[hole] = entry;
+    }
+
+    void pop() 
+    {
+        TimeoutEntry last = entries_.back();
+        entries_.pop_back();
+        size_t size = entries_.size();
+        if (size == 0) return;
+        size_t hole = 0;
+        for (size_t child = 1; child < size; child = 2 * hole + 1) 
+        {
+            if (child + 1 < size && entries_[child] > entries_[child + 1]) child++;
+            if (!(last > entries_[child])) break;
+            entries_[hole] = entries_[child];
+            hole = child;
+        }
+        entries_[hole] = last;
+    }
+
+private:
+    std::vector<TimeoutEntry> entries_;
+};
+
+class Receiver;
+
+// Unacked messages are keyed by (original sender, seq): in broadcast mode one link
+// relays messages from every origin, so seq alone is not unique.
+inline uint64_t messageKey(uint32_t sender_id, uint32_t seq_number)
+{
+    return (static_cast<uint64_t>(sender_id) << 32) | seq_number;
+}
+
 class Sender 
 {
 public:
-    Sender(UDPSocket* socket, uint32_t my_id, const Host& receiver, Logger* logger);
+    // ack_source != nullptr selects broadcast framing: outgoing DATA piggybacks the
+    // ACKs ack_source owes to the same peer. logger may be nullptr (broadcast layer logs itself).
+    // tracer != nullptr attaches known trace stamps to BROADCAST_DATA.
+    Sender(Transport* socket, uint32_t my_id, const Peer& receiver, Logger* logger,
+           Receiver* ack_source = nullptr, const LatencyTracer* tracer = nullptr);
     ~Sender();
     
     void start();
     void stop();
-    void send(uint32_t original_sender_id, uint32_t seq_number);
+    // Busy-poll mode: sendLoop polls the empty queue this long before sleeping on queue_cv_,
+    // so a message enqueued right after a batch skips the futex wakeup. Set before start().
+    void setSpinBeforeBlock(std::chrono::microseconds spin) { spin_ = spin; }
+    // CPUs for the send / retransmit threads (per this peer's index). Set before start().
+    void setPlacement(const ThreadPlacement& placement) { placement_ = placement; }
+    // payload != nullptr sends the message with its body (BROADCAST_PAYLOAD framing); the
+    // Sender keeps only the reference until the message is ACKed.
+    void send(uint32_t original_sender_id, uint32_t seq_number, SharedPayload payload = nullptr);
+    // Reliable delivery of an opaque payload from this process (PERFECT_LINK_PAYLOAD framing).
+    // The Sender numbers these itself; don't mix with send() on the same Sender.
+    uint32_t sendPayload(std::vector<uint8_t> payload);
+    void handleAck(const Packet& packet);
     
+    // Returns once every message is ACKed, the Sender is stopped, or abortWait() was called
     void waitUntilAllAcked();
+    void abortWait();
     bool allMessagesAcked() const;
 
 private:
-    UDPSocket* socket_;
+    Transport* socket_;
     uint32_t my_id_;
-    Host receiver_;
+    const Peer& receiver_;
     Logger* logger_;
+    Receiver* ack_source_;
+    const LatencyTracer* tracer_;
     
-    std::queue<std::pair<uint32_t, uint32_t>> pending_queue_;
-    std::map<uint32_t, SentMessage> unacked_messages_;
-    std::priority_queue<TimeoutEntry, std::vector<TimeoutEntry>, std::greater<>> timeout_queue_;
+    // Steady state allocates nothing: queue blocks and map nodes come back through pools
+    // guarded by queue_mutex_ / data_mutex_, like the containers themselves.
+    using UnackedEntry = std::pair<const uint64_t, SentMessage>;
+    NodePool queue_pool_;
+    NodePool unacked_pool_;
+    std::queue<PendingMessage, std::deque<PendingMessage, PoolAllocator<PendingMessage>>> pending_queue_;
+    std::map<uint64_t, SentMessage, std::less<uint64_t>, PoolAllocator<UnackedEntry>> unacked_messages_;
+    uint32_t next_payload_seq_;
+    TimeoutHeap timeout_queue_;
     
     mutable std::mutex queue_mutex_;
     mutable std::mutex data_mutex_;
     std::condition_variable queue_cv_;
     std::condition_variable timeout_cv_;
+    std::condition_variable acked_cv_;     // with data_mutex_: unacked_messages_ drained
+    std::atomic<bool> wait_aborted_;
+    std::chrono::microseconds spin_;
+    ThreadPlacement placement_;
     
     std::thread send_thread_;
     std::thread retransmit_thread_;
-    std::thread ack_receive_thread_;
     std::atomic<bool> running_;
     
     static constexpr std::chrono::milliseconds TIMEOUT{50};
     static constexpr size_t MAX_BATCH_SIZE = 16;
+    static constexpr size_t MAX_BURST_PACKETS = 32;  // DATA packets per wakeup, sent as one GSO buffer
+    static constexpr size_t MAX_PAYLOAD_PACKET_BYTES = 8192;  // larger single payloads go alone
     
     void sendLoop();
     void retransmitLoop();
-    void ackReceiveLoop();
+    void transmit(OutgoingPacket& out, const PendingMessage* messages, size_t count, bool retransmission);
+    void clearAcked(uint64_t key, std::chrono::steady_clock::time_point now);
 };
 
 class Receiver 
 {
 public:
-    Receiver(UDPSocket* socket, Logger* logger);
+    // piggyback = true (broadcast mode): ACKs wait up to ACK_FLUSH_TIMEOUT for a Sender to
+    // carry them on reverse DATA; only ACKs older than that go out as BROADCAST_ACK.
+    // logger == nullptr disables link-level delivery logging and dedupe.
+    Receiver(Transport* socket, const PeerDirectory& peers, Logger* logger, bool piggyback = false);
     ~Receiver();
     
     void start();
     void stop();
-    void handle(const Packet& packet, const std::string& sender_ip, uint16_t sender_port);
+    void handle(const Packet& packet, uint32_t peer_index);
     void flushAllPendingAcks();
+    void takePendingAcks(uint32_t peer_index, std::vector<Message>& out);
+    // CPU for the flush thread. Set before start().
+    void setPlacement(const ThreadPlacement& placement) { placement_ = placement; }
+
+    static constexpr size_t MAX_ACKS_PER_PACKET = 32;
 
 private:
+    struct PendingAcks 
+    {
+        std::vector<Message> acks;
+        std::chrono::steady_clock::time_point oldest;
+    };
+
     void flushLoop();
+    void sendAcks(uint32_t peer_index, std::vector<Message>& ack_list);
 
-    UDPSocket* socket_;
+    Transport* socket_;
+    const PeerDirectory& peers_;
     Logger* logger_;
+    bool piggyback_;
     
-    std::map<uint32_t, std::set<uint32_t>> delivered_messages_;
-    std::map<std::string, std::vector<uint32_t>> pending_acks_;
+    // Per original sender: every seq up to watermark has been delivered, and so have those in
+    // above. Exact at any age of a duplicate; above only holds what arrived past the first gap.
+    struct DeliveredSeqs 
+    {
+        uint32_t watermark;
+        std::set<uint32_t, std::less<uint32_t>, PoolAllocator<uint32_t>> above;
+        
+        explicit DeliveredSeqs(const PoolAllocator<uint32_t>& allocator) : watermark(0), above(allocator) {}
+    };
+    NodePool delivered_pool_;  // every DeliveredSeqs::above's nodes, guarded by mtx_
+    std::map<uint32_t, DeliveredSeqs> delivered_messages_;
+    std::vector<PendingAcks> pending_acks_;  // indexed by peer index
+    OutgoingPacket ack_out_;  // guarded by mtx_
     
     std::mutex mtx_;
+    ThreadPlacement placement_;
     std::thread flush_thread_;
     std::atomic<bool> flush_running_;
     
-    static constexpr size_t MAX_DELIVERED_WINDOW = 10000;
     static constexpr size_t ACK_BATCH_SIZE = 8;
     static constexpr std::chrono::milliseconds ACK_FLUSH_TIMEOUT{1};
 };
@@ -111,31 +247,39 @@ private:
 class PerfectLinkApp 
 {
 public:
+    // transport == nullptr binds a UDPSocket on our hosts-file port; otherwise the app owns it.
     PerfectLinkApp(uint32_t my_id, const std::vector<Host>& hosts,
-                   uint32_t m, uint32_t receiver_id, const std::string& output_path);
+                   uint32_t m, uint32_t receiver_id, const std::string& output_path,
+                   const RuntimeOptions& options = RuntimeOptions(), Transport* transport = nullptr);
     ~PerfectLinkApp();
     
     void run();
+    // Makes a run() that is waiting for ACKs return; safe from another thread at any time.
+    void interrupt();
     void shutdown();
     bool isSender() const { return sender_ != nullptr; }
+    // One received datagram through lookup, decode and dispatch; receiveLoop's body, public
+    // so that captures can be replayed without the socket.
+    void handleDatagram(const std::vector<uint8_t>& data, const sockaddr_in& sender_addr);
 
 private:
     uint32_t my_id_;
-    std::vector<Host> hosts_;
+    PeerDirectory peers_;
     uint32_t m_;
     uint32_t receiver_id_;
+    RuntimeOptions options_;
     
-    UDPSocket* receiver_socket_;
-    UDPSocket* sender_socket_;
+    Transport* socket_;  // owned; a UDPSocket unless one was passed in
     Sender* sender_;
     Receiver* receiver_;
     Logger* logger_;
+    PacketCaptureWriter* capture_;  // nullptr unless DA_CAPTURE=on
+    Packet rx_packet_;  // handleDatagram's decode target, reused so decoding doesn't allocate
     
     std::thread receive_thread_;
     std::atomic<bool> running_;
     
     void receiveLoop();
-    Host findHost(uint32_t id) const;
 };
 
 }
@@ -6,20 +6,17 @@
 
 Config Config::parse(const std::string& config_path) 
 {
-    std::cout << "[DEBUG] Config::parse() reading: " << config_path << std::endl;
-    
     Config config;
     std::ifstream file(config_path);
     
     if (!file.is_open()) 
     {
-        std::cerr << "[DEBUG] Config::parse() failed to open file" << std::endl;
+        std::cerr << "Cannot open config file " << config_path << std::endl;
         return config;
     }
     
     std::string first_line;
     std::getline(file, first_line);
-    std::cout << "[DEBUG] Config first_line: '" << first_line << "'" << std::endl;
     
     std::istringstream iss(first_line);
     uint32_t first_num, second_num, third_num;
@@ -36,20 +33,9 @@ Config Config::parse(const std::string& config_path)
             config.lattice_agreement_config_.max_values = second_num;
             config.lattice_agreement_config_.distinct_values = third_num;
             
-            // Parse proposal sets
-            std::string line;
-            while (std::getline(file, line)) 
-            {
-                std::istringstream line_iss(line);
-                std::vector<uint32_t> proposal_set;
-                uint32_t value;
-                while (line_iss >> value) {
-                    proposal_set.push_back(value);
-                }
-                if (!proposal_set.empty()) {
-                    config.lattice_agreement_config_.proposal_sets.push_back(proposal_set);
-                }
-            }
+            // Proposal lines are not materialized here: the lattice app maps the file
+            // and pulls them one shot at a time.
+            config.lattice_agreement_config_.path = config_path;
         } 
         else 
         {
@@ -57,8 +43,6 @@ Config Config::parse(const std::string& config_path)
             config.type_ = ConfigType::PERFECT_LINK;
             config.perfect_link_config_.m = first_num;
             config.perfect_link_config_.receiver_id = second_num;
-            std::cout << "[DEBUG] Parsed Perfect Link config: m=" << first_num 
-                      << ", receiver_id=" << second_num << std::endl;
         }
     } 
     else 
@@ -0,0 +1,108 @@
+#include "common/latency_tracer.hpp"
+#include "common/metrics.hpp"
+#include <chrono>
+
+static uint64_t sample_key(uint32_t origin_id, uint32_t seq)
+{
+    return (static_cast<uint64_t>(origin_id) << 32) | seq;
+}
+
+LatencyTracer::LatencyTracer(uint32_t sample_every)
+    : sample_every_(sample_every == 0 ? 1 : sample_every) {}
+
+uint64_t LatencyTracer::nowMicros()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+// caller holds mtx_
+bool LatencyTracer::finished(uint32_t origin_id, uint32_t seq) const
+{
+    auto it = fifo_through_.find(origin_id);
+    return it != fifo_through_.end() && seq <= it->second;
+}
+
+// caller holds mtx_
+LatencyTracer::Sample& LatencyTracer::sampleFor(uint32_t origin_id, uint32_t seq)
+{
+    if (samples_.size() >= MAX_PENDING)
+    {
+        samples_.erase(samples_.begin());
+    }
+    return samples_[sample_key(origin_id, seq)];
+}
+
+void LatencyTracer::stampBroadcast(uint32_t origin_id, uint32_t seq)
+{
+    if (!sampled(seq)) return;
+    std::lock_guard<std::mutex> lock(mtx_);
+    sampleFor(origin_id, seq).broadcast_us = nowMicros();
+}
+
+void LatencyTracer::learnStamps(uint32_t origin_id, const std::vector<TraceStamp>& stamps)
+{
+    if (stamps.empty()) return;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const TraceStamp& stamp : stamps)
+    {
+        if (!sampled(stamp.seq) || stamp.broadcast_us == 0 || finished(origin_id, stamp.seq)) continue;
+        auto it = samples_.find(sample_key(origin_id, stamp.seq));
+        if (it != samples_.end() && it->second.broadcast_us != 0) continue;
+        Sample& sample = it != samples_.end() ? it->second : sampleFor(origin_id, stamp.seq);
+        sample.broadcast_us = stamp.broadcast_us;
+        recordIfComplete(origin_id, stamp.seq);
+    }
+}
+
+void LatencyTracer::attachStamps(uint32_t origin_id, const std::vector<uint32_t>& seqs,
+                                 std::vector<TraceStamp>& out) const
+{
+    bool any = false;
+    for (uint32_t seq : seqs) any = any || sampled(seq);
+    if (!any) return;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (uint32_t seq : seqs)
+    {
+        if (!sampled(seq)) continue;
+        auto it = samples_.find(sample_key(origin_id, seq));
+        if (it != samples_.end() && it->second.broadcast_us != 0)
+        {
+            out.emplace_back(seq, it->second.broadcast_us);
+        }
+    }
+}
+
+void LatencyTracer::urbDelivered(uint32_t origin_id, uint32_t seq)
+{
+    if (!sampled(seq)) return;
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (finished(origin_id, seq)) return;
+    sampleFor(origin_id, seq).urb_us = nowMicros();
+}
+
+void LatencyTracer::fifoDelivered(uint32_t origin_id, uint32_t seq)
+{
+    if (!sampled(seq)) return;
+    std::lock_guard<std::mutex> lock(mtx_);
+    fifo_through_[origin_id] = seq;
+    Sample& sample = sampleFor(origin_id, seq);
+    sample.fifo_us = nowMicros();
+    if (sample.urb_us == 0) sample.urb_us = sample.fifo_us;
+    recordIfComplete(origin_id, seq);
+}
+
+// caller holds mtx_. Once both ends are known the sample is recorded and forgotten, so
+// relays after local delivery go out unstamped (the first copies already carried it).
+void LatencyTracer::recordIfComplete(uint32_t origin_id, uint32_t seq)
+{
+    auto it = samples_.find(sample_key(origin_id, seq));
+    if (it == samples_.end()) return;
+    const Sample& sample = it->second;
+    if (sample.broadcast_us == 0 || sample.fifo_us == 0) return;
+    uint64_t to_urb = sample.urb_us > sample.broadcast_us ? sample.urb_us - sample.broadcast_us : 0;
+    uint64_t to_fifo = sample.fifo_us > sample.broadcast_us ? sample.fifo_us - sample.broadcast_us : 0;
+    metrics::recordOrigin(metrics::OriginHistogram::BROADCAST_TO_URB_US, origin_id, to_urb);
+    metrics::recordOrigin(metrics::OriginHistogram::BROADCAST_TO_FIFO_US, origin_id, to_fifo);
+    samples_.erase(it);
+}
@@ -1,16 +1,76 @@
 #include "common/logger.hpp"
-#include <fstream>
+#include "common/metrics.hpp"
+#include "common/tracepoints.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
-Logger::Logger(const std::string& output_path) 
-    : output_path_(output_path) 
+// RANGES file: magic, then one record per run:
+//   varint tag (0 = "b", else the sender of "d"), varint zigzag(first_seq - end of the
+//   previous run with that tag, starting at 1), varint count - 1
+static const char RANGES_MAGIC[8] = {'D', 'A', 'R', 'N', 'G', '0', '0', '1'};
+static constexpr size_t EXPAND_CHUNK_BYTES = 1 << 20;
+
+static void put_varint(std::vector<uint8_t>& buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<uint8_t>(value));
+}
+
+static bool write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+static void append_uint(std::string& text, uint32_t value)
 {
-    buffer_.reserve(10000);
+    char digits[10];
+    text.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+}
+
+Logger::Logger(const std::string& output_path, LogFormat format) 
+    : output_path_(output_path), format_(format), output_fd_(-1), text_lines_(0), ranges_fd_(-1), run_tag_(0), run_first_(0), run_count_(0)
+{
+    if (format_ == LogFormat::TEXT)
+    {
+        text_.reserve(TEXT_RESERVE_BYTES);
+        return;
+    }
+    ranges_path_ = output_path + ".ranges";
+    ranges_fd_ = ::open(ranges_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (ranges_fd_ < 0)
+    {
+        throw std::runtime_error("Failed to open " + ranges_path_);
+    }
+    ranges_buffer_.reserve(RANGES_WRITE_BYTES + 64);
+    ranges_buffer_.insert(ranges_buffer_.end(), std::begin(RANGES_MAGIC), std::end(RANGES_MAGIC));
 }
 
 Logger::~Logger() 
 {
-    flush();
+    close();
+    if (output_fd_ >= 0) ::close(output_fd_);
 }
 
 void Logger::logBroadcast(uint32_t seq_number) 
@@ -18,8 +78,16 @@ void Logger::logBroadcast(uint32_t seq_number)
     //创建一个名为 lock 的临时对象，它会在构造时自动锁住 mtx_，在销毁时自动解锁
     //lock_guard 的生命周期和 logBroadcast 函数的局部作用域绑定。当函数执行完毕并离开作用域，lock_guard 自动释放锁
     std::lock_guard<std::mutex> lock(mtx_);
-    buffer_.push_back("b " + std::to_string(seq_number));
-    if (buffer_.size() >= FLUSH_THRESHOLD) 
+    if (format_ == LogFormat::RANGES)
+    {
+        appendEvent(0, seq_number);
+        return;
+    }
+    text_ += "b ";
+    append_uint(text_, seq_number);
+    text_ += '\n';
+    text_lines_++;
+    if (text_.size() >= TEXT_FLUSH_BYTES) 
     {
         flushInternal();
     }
@@ -27,9 +95,41 @@ void Logger::logBroadcast(uint32_t seq_number)
 
 void Logger::logDelivery(uint32_t sender_id, uint32_t seq_number) 
 {
+    metrics::add(metrics::Counter::DELIVERIES);
     std::lock_guard<std::mutex> lock(mtx_);
-    buffer_.push_back("d " + std::to_string(sender_id) + " " + std::to_string(seq_number));
-    if (buffer_.size() >= FLUSH_THRESHOLD) 
+    if (format_ == LogFormat::RANGES)
+    {
+        appendEvent(sender_id, seq_number);
+        return;
+    }
+    text_ += "d ";
+    append_uint(text_, sender_id);
+    text_ += ' ';
+    append_uint(text_, seq_number);
+    text_ += '\n';
+    text_lines_++;
+    if (text_.size() >= TEXT_FLUSH_BYTES) 
+    {
+        flushInternal();
+    }
+}
+
+void Logger::logDecision(const std::vector<uint32_t>& values) 
+{
+    metrics::add(metrics::Counter::DELIVERIES);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (format_ == LogFormat::RANGES)
+    {
+        throw std::runtime_error("Logger: decisions can only be logged as text");
+    }
+    for (size_t i = 0; i < values.size(); i++) 
+    {
+        if (i > 0) text_ += ' ';
+        append_uint(text_, values[i]);
+    }
+    text_ += '\n';
+    text_lines_++;
+    if (text_.size() >= TEXT_FLUSH_BYTES) 
     {
         flushInternal();
     }
@@ -38,29 +138,201 @@ void Logger::logDelivery(uint32_t sender_id, uint32_t seq_number)
 void Logger::flush() 
 {
     std::lock_guard<std::mutex> lock(mtx_);
+    if (format_ == LogFormat::RANGES)
+    {
+        closeRun();
+        writeRanges();
+        return;
+    }
     flushInternal();
 }
 
-void Logger::flushInternal() 
+void Logger::close() 
 {
-    if (buffer_.empty()) 
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (format_ == LogFormat::RANGES)
     {
+        closeRun();
+        writeRanges();
+        ::close(ranges_fd_);
+        ranges_fd_ = -1;
+        int64_t lines = expandRanges(ranges_path_, output_path_);
+        if (lines >= 0)
+        {
+            std::remove(ranges_path_.c_str());
+        }
+        format_ = LogFormat::TEXT;
+    }
+    flushInternal();
+}
+
+void Logger::appendEvent(uint32_t tag, uint32_t seq_number) 
+{
+    // O(1): extend the open run, or seal it and start a new one
+    if (run_count_ > 0 && tag == run_tag_ && seq_number == run_first_ + run_count_)
+    {
+        run_count_++;
         return;
     }
-    
-    std::ofstream file(output_path_, std::ios::app);
-    if (!file.is_open()) 
+    closeRun();
+    run_tag_ = tag;
+    run_first_ = seq_number;
+    run_count_ = 1;
+}
+
+void Logger::closeRun() 
+{
+    if (run_count_ == 0)
+    {
+        return;
+    }
+    if (ranges_next_.size() <= run_tag_)
+    {
+        ranges_next_.resize(run_tag_ + 1, 1);
+    }
+    int64_t delta = static_cast<int64_t>(run_first_) - static_cast<int64_t>(ranges_next_[run_tag_]);
+    put_varint(ranges_buffer_, run_tag_);
+    put_varint(ranges_buffer_, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+    put_varint(ranges_buffer_, run_count_ - 1);
+    ranges_next_[run_tag_] = run_first_ + run_count_;
+    run_count_ = 0;
+    if (ranges_buffer_.size() >= RANGES_WRITE_BYTES)
+    {
+        writeRanges();
+    }
+}
+
+void Logger::writeRanges() 
+{
+    if (ranges_buffer_.empty() || ranges_fd_ < 0)
+    {
+        return;
+    }
+    DA_PROBE1(logger_flush, ranges_buffer_.size());
+    metrics::add(metrics::Counter::LOG_WRITES);
+    metrics::add(metrics::Counter::LOG_BYTES, ranges_buffer_.size());
+    if (!write_all(ranges_fd_, reinterpret_cast<const char*>(ranges_buffer_.data()), ranges_buffer_.size()))
+    {
+        std::cerr << "Logger: failed to write " << ranges_path_ << ": " << std::strerror(errno) << std::endl;
+    }
+    ranges_buffer_.clear();
+}
+
+int64_t Logger::expandRanges(const std::string& ranges_path, const std::string& text_path) 
+{
+    int in = ::open(ranges_path.c_str(), O_RDONLY);
+    if (in < 0)
+    {
+        return -1;
+    }
+    int out = ::open(text_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (out < 0)
+    {
+        ::close(in);
+        return -1;
+    }
+
+    std::vector<uint8_t> input(EXPAND_CHUNK_BYTES);
+    size_t pos = 0, end = 0;
+    bool eof = false;
+    // next byte of the file, refilling the chunk as needed; false at the end
+    auto next_byte = [&](uint8_t& byte) {
+        if (pos == end)
+        {
+            if (eof) return false;
+            ssize_t got = ::read(in, input.data(), input.size());
+            while (got < 0 && errno == EINTR) got = ::read(in, input.data(), input.size());
+            if (got <= 0)
+            {
+                eof = true;
+                return false;
+            }
+            pos = 0;
+            end = static_cast<size_t>(got);
+        }
+        byte = input[pos++];
+        return true;
+    };
+    auto next_varint = [&](uint64_t& value) {
+        value = 0;
+        uint8_t byte = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (!next_byte(byte)) return false;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    };
+
+    int64_t lines = 0;
+    uint8_t byte = 0;
+    bool valid = true;
+    for (size_t i = 0; i < sizeof(RANGES_MAGIC) && valid; i++)
+    {
+        valid = next_byte(byte) && byte == static_cast<uint8_t>(RANGES_MAGIC[i]);
+    }
+    std::string text;
+    text.reserve(EXPAND_CHUNK_BYTES + 64);
+    std::vector<uint32_t> next_seq;
+    uint64_t tag = 0, zigzag = 0, count = 0;
+    while (valid && next_varint(tag) && next_varint(zigzag) && next_varint(count))
+    {
+        if (next_seq.size() <= tag)
+        {
+            next_seq.resize(tag + 1, 1);
+        }
+        int64_t delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        uint32_t seq = static_cast<uint32_t>(static_cast<int64_t>(next_seq[tag]) + delta);
+        // every line of a run shares the "d <sender> " prefix
+        std::string prefix = tag == 0 ? "b " : "d " + std::to_string(tag) + " ";
+        for (uint64_t k = 0; k <= count; k++, seq++)
+        {
+            text += prefix;
+            char digits[16];
+            char* digits_end = std::to_chars(digits, digits + sizeof(digits), seq).ptr;
+            text.append(digits, digits_end);
+            text += '\n';
+            if (text.size() >= EXPAND_CHUNK_BYTES)
+            {
+                write_all(out, text.data(), text.size());
+                text.clear();
+            }
+        }
+        next_seq[tag] = seq;
+        lines += static_cast<int64_t>(count + 1);
+    }
+    write_all(out, text.data(), text.size());
+    ::close(in);
+    ::close(out);
+    return lines;
+}
+
+void Logger::flushInternal() 
+{
+    if (text_.empty()) 
     {
-        std::cerr << "[DEBUG] Logger: Failed to open file: " << output_path_ << std::endl;
         return;
     }
+    DA_PROBE1(logger_flush, text_lines_);
     
-    for (const std::string& line : buffer_) 
+    if (output_fd_ < 0) 
     {
-        file << line << "\n";
+        output_fd_ = ::open(output_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (output_fd_ < 0) 
+        {
+            std::cerr << "Logger: failed to open " << output_path_ << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
     }
     
-    file.close();
-    std::cout << "[DEBUG] Logger: Flushed " << buffer_.size() << " lines to " << output_path_ << std::endl;
-    buffer_.clear();
+    //所有行已经连续地放在text_里，一次write写出
+    metrics::add(metrics::Counter::LOG_WRITES);
+    metrics::add(metrics::Counter::LOG_BYTES, text_.size());
+    if (!write_all(output_fd_, text_.data(), text_.size())) 
+    {
+        std::cerr << "Logger: failed to write " << output_path_ << ": " << std::strerror(errno) << std::endl;
+    }
+    text_.clear();
+    text_lines_ = 0;
 }
\ No newline at end of file
@@ -0,0 +1,397 @@
+#include "common/metrics.hpp"
+#include "common/threads.hpp"
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace metrics
+{
+
+static const char* const COUNTER_NAMES[COUNTERS] = {
+    "packets_sent",
+    "bytes_sent",
+    "packets_received",
+    "bytes_received",
+    "gso_sends",
+    "gro_receives",
+    "data_packets_sent",
+    "retransmissions",
+    "ack_packets_sent",
+    "acks_piggybacked",
+    "acks_received",
+    "deliveries",
+    "payload_mismatches",
+    "log_writes",
+    "log_bytes",
+    "shutdown_us",
+};
+
+static const char* const PEER_COUNTER_NAMES[PEER_COUNTERS] = {
+    "packets_sent",
+    "packets_received",
+    "retransmissions",
+};
+
+static const char* const HISTOGRAM_NAMES[HISTOGRAMS] = {
+    "ack_rtt_us",
+    "ack_batch_size",
+    "send_queue_depth",
+    "unacked_depth",
+    "fifo_holdback_us",
+    "decision_latency_us",
+};
+
+static const char* const ORIGIN_HISTOGRAM_NAMES[ORIGIN_HISTOGRAMS] = {
+    "broadcast_to_urb_us",
+    "broadcast_to_fifo_us",
+};
+
+// Slabs form a push-only list: threads come and go but their counts must survive them.
+static std::atomic<Slab*> slabs(nullptr);
+static const std::chrono::steady_clock::time_point process_start = std::chrono::steady_clock::now();
+
+Slab::Slab() : next(nullptr)
+{
+    clear();
+}
+
+void Slab::clear()
+{
+    for (auto& cell : counters) cell.store(0, std::memory_order_relaxed);
+    for (auto& row : peer_counters)
+    {
+        for (auto& cell : row) cell.store(0, std::memory_order_relaxed);
+    }
+    for (auto& cell : histogram_sums) cell.store(0, std::memory_order_relaxed);
+    for (auto& row : buckets)
+    {
+        for (auto& cell : row) cell.store(0, std::memory_order_relaxed);
+    }
+}
+
+Slab* attachThread()
+{
+    Slab* slab = new Slab();
+    Slab* head = slabs.load(std::memory_order_relaxed);
+    do
+    {
+        slab->next = head;
+    } while (!slabs.compare_exchange_weak(head, slab, std::memory_order_release, std::memory_order_relaxed));
+    return slab;
+}
+
+struct OriginRow
+{
+    std::vector<uint64_t> buckets[ORIGIN_HISTOGRAMS];
+    uint64_t sums[ORIGIN_HISTOGRAMS] = {};
+
+    OriginRow()
+    {
+        for (auto& row : buckets) row.assign(HISTOGRAM_BUCKETS, 0);
+    }
+};
+
+static std::mutex origin_mutex;
+static std::map<uint32_t, OriginRow> origin_rows;
+
+void recordOrigin(OriginHistogram histogram, uint32_t origin_id, uint64_t value)
+{
+    size_t h = static_cast<size_t>(histogram);
+    std::lock_guard<std::mutex> lock(origin_mutex);
+    OriginRow& row = origin_rows[origin_id];
+    row.buckets[h][bucketOf(value)]++;
+    row.sums[h] += value;
+}
+
+// ======================
+// Thread usage
+// ======================
+
+struct ThreadRow
+{
+    std::string name;
+    pid_t tid;
+    uint32_t cpu;
+    bool pinned;
+    bool running;
+    uint64_t cpu_ns;        // frozen at detach; read from /proc while running
+    uint64_t voluntary;
+    uint64_t involuntary;
+};
+
+static std::mutex thread_mutex;
+static std::list<ThreadRow> thread_rows;
+static thread_local ThreadRow* current_thread_row = nullptr;
+
+void attachThreadUsage(const std::string& name, uint32_t cpu, bool pinned)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    thread_rows.push_back({name, tid, cpu, pinned, true, 0, 0, 0});
+    current_thread_row = &thread_rows.back();
+}
+
+void detachThreadUsage()
+{
+    if (current_thread_row == nullptr) return;
+    timespec cpu_time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    ThreadRow& row = *current_thread_row;
+    row.cpu_ns = static_cast<uint64_t>(cpu_time.tv_sec) * 1000000000ull + static_cast<uint64_t>(cpu_time.tv_nsec);
+    row.voluntary = static_cast<uint64_t>(usage.ru_nvcsw);
+    row.involuntary = static_cast<uint64_t>(usage.ru_nivcsw);
+    row.running = false;
+    current_thread_row = nullptr;
+}
+
+// Another thread's counters, from /proc/self/task/<tid>/{schedstat,status}. The caller
+// holds thread_mutex, so a running row's thread has not passed detach and its tid is valid.
+static void read_running(ThreadRow& row)
+{
+    std::string task = "/proc/self/task/" + std::to_string(row.tid);
+    std::ifstream schedstat(task + "/schedstat");
+    schedstat >> row.cpu_ns;
+    std::ifstream status(task + "/status");
+    std::string key;
+    while (status >> key)
+    {
+        if (key == "voluntary_ctxt_switches:") status >> row.voluntary;
+        else if (key == "nonvoluntary_ctxt_switches:") status >> row.involuntary;
+    }
+}
+
+static void write_threads(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    for (ThreadRow& row : thread_rows)
+    {
+        if (row.running) read_running(row);
+        out << "thread " << row.name << " tid=" << row.tid << " cpu=";
+        if (row.cpu == NO_CPU) out << "-";
+        else if (!row.pinned) out << "- pin_failed=" << row.cpu;
+        else out << row.cpu;
+        out << " cpu_us=" << row.cpu_ns / 1000 << " voluntary_switches=" << row.voluntary
+            << " involuntary_switches=" << row.involuntary << " state=" << (row.running ? "running" : "exited")
+            << "\n";
+    }
+}
+
+void reset()
+{
+    for (Slab* slab = slabs.load(std::memory_order_acquire); slab != nullptr; slab = slab->next)
+    {
+        slab->clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(thread_mutex);
+        thread_rows.remove_if([](const ThreadRow& row) { return !row.running; });
+    }
+    std::lock_guard<std::mutex> lock(origin_mutex);
+    origin_rows.clear();
+}
+
+uint64_t bucketUpperBound(size_t bucket)
+{
+    if (bucket < SUB_BUCKETS) return bucket;
+    uint32_t exponent = static_cast<uint32_t>(bucket / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    uint32_t shift = exponent - SUB_BUCKET_BITS;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+struct Snapshot
+{
+    uint64_t counters[COUNTERS] = {};
+    uint64_t peer_counters[PEER_COUNTERS][MAX_PEERS] = {};
+    uint64_t histogram_sums[HISTOGRAMS] = {};
+    std::vector<uint64_t> buckets[HISTOGRAMS];
+
+    Snapshot()
+    {
+        for (auto& row : buckets) row.assign(HISTOGRAM_BUCKETS, 0);
+    }
+};
+
+uint64_t total(Counter counter)
+{
+    uint64_t sum = 0;
+    for (Slab* slab = slabs.load(std::memory_order_acquire); slab != nullptr; slab = slab->next)
+    {
+        sum += slab->counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+static void collect(Snapshot& snapshot)
+{
+    for (Slab* slab = slabs.load(std::memory_order_acquire); slab != nullptr; slab = slab->next)
+    {
+        for (size_t c = 0; c < COUNTERS; c++)
+        {
+            snapshot.counters[c] += slab->counters[c].load(std::memory_order_relaxed);
+        }
+        for (size_t c = 0; c < PEER_COUNTERS; c++)
+        {
+            for (size_t p = 0; p < MAX_PEERS; p++)
+            {
+                snapshot.peer_counters[c][p] += slab->peer_counters[c][p].load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t h = 0; h < HISTOGRAMS; h++)
+        {
+            snapshot.histogram_sums[h] += slab->histogram_sums[h].load(std::memory_order_relaxed);
+            for (size_t b = 0; b < HISTOGRAM_BUCKETS; b++)
+            {
+                snapshot.buckets[h][b] += slab->buckets[h][b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+static void write_histogram(std::ostream& out, const char* name, const std::vector<uint64_t>& buckets,
+                            uint64_t sum)
+{
+    static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    static const char* const QUANTILE_NAMES[] = {"p50", "p90", "p99", "p999"};
+
+    uint64_t count = 0;
+    size_t max_bucket = 0;
+    for (size_t b = 0; b < buckets.size(); b++)
+    {
+        count += buckets[b];
+        if (buckets[b] != 0) max_bucket = b;
+    }
+    out << "hist " << name << " count=" << count;
+    if (count == 0)
+    {
+        out << "\n";
+        return;
+    }
+    out << " mean=" << sum / count;
+    size_t b = 0;
+    uint64_t seen = 0;
+    for (size_t q = 0; q < 4; q++)
+    {
+        uint64_t rank = static_cast<uint64_t>(QUANTILES[q] * static_cast<double>(count - 1)) + 1;
+        while (seen + buckets[b] < rank) seen += buckets[b++];
+        out << " " << QUANTILE_NAMES[q] << "=" << bucketUpperBound(b);
+    }
+    out << " max=" << bucketUpperBound(max_bucket) << "\n";
+}
+
+void dump(const std::string& path)
+{
+    Snapshot snapshot;
+    collect(snapshot);
+    std::map<uint32_t, OriginRow> origins;
+    {
+        std::lock_guard<std::mutex> lock(origin_mutex);
+        origins = origin_rows;
+    }
+
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        if (!out.is_open())
+        {
+            // The reporter retries every interval; say so once, not on each attempt.
+            static std::atomic<bool> reported(false);
+            if (!reported.exchange(true)) std::cerr << "Cannot write metrics to " << tmp_path << std::endl;
+            return;
+        }
+        out << "uptime_ms "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - process_start).count() << "\n";
+        for (size_t c = 0; c < COUNTERS; c++)
+        {
+            out << COUNTER_NAMES[c] << " " << snapshot.counters[c] << "\n";
+        }
+        for (size_t p = 0; p < MAX_PEERS; p++)
+        {
+            bool any = false;
+            for (size_t c = 0; c < PEER_COUNTERS; c++) any = any || snapshot.peer_counters[c][p] != 0;
+            if (!any) continue;
+            out << "peer " << p;
+            for (size_t c = 0; c < PEER_COUNTERS; c++)
+            {
+                out << " " << PEER_COUNTER_NAMES[c] << "=" << snapshot.peer_counters[c][p];
+            }
+            out << "\n";
+        }
+        for (size_t h = 0; h < HISTOGRAMS; h++)
+        {
+            write_histogram(out, HISTOGRAM_NAMES[h], snapshot.buckets[h], snapshot.histogram_sums[h]);
+        }
+        for (const auto& [origin, row] : origins)
+        {
+            for (size_t h = 0; h < ORIGIN_HISTOGRAMS; h++)
+            {
+                std::string name = "origin." + std::to_string(origin) + "." + ORIGIN_HISTOGRAM_NAMES[h];
+                write_histogram(out, name.c_str(), row.buckets[h], row.sums[h]);
+            }
+        }
+        write_threads(out);
+    }
+    std::rename(tmp_path.c_str(), path.c_str());
+}
+
+// ======================
+// Reporter
+// ======================
+
+static std::mutex reporter_mutex;
+static std::condition_variable reporter_cv;
+static std::thread reporter_thread;
+static std::string reporter_path;
+static bool reporter_running = false;
+
+void startReporter(const std::string& path, uint32_t interval_ms)
+{
+    std::lock_guard<std::mutex> lock(reporter_mutex);
+    if (reporter_running) return;
+    reporter_path = path;
+    reporter_running = true;
+    if (interval_ms == 0) return;
+    reporter_thread = std::thread([interval_ms] {
+        attachThreadUsage("metrics", NO_CPU);
+        std::unique_lock<std::mutex> lock(reporter_mutex);
+        while (reporter_running)
+        {
+            if (reporter_cv.wait_for(lock, std::chrono::milliseconds(interval_ms),
+                                     [] { return !reporter_running; }))
+            {
+                break;
+            }
+            dump(reporter_path);
+        }
+        detachThreadUsage();
+    });
+}
+
+void stopReporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(reporter_mutex);
+        if (!reporter_running) return;
+        reporter_running = false;
+    }
+    reporter_cv.notify_all();
+    if (reporter_thread.joinable()) reporter_thread.join();
+    dump(reporter_path);
+}
+
+}
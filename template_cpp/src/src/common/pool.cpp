@@ -0,0 +1,67 @@
+#include "common/pool.hpp"
+#include <algorithm>
+
+// ======================
+// NodePool
+// ======================
+
+static size_t round_up(size_t bytes)
+{
+    size_t align = alignof(std::max_align_t);
+    return (std::max(bytes, sizeof(void*)) + align - 1) / align * align;
+}
+
+NodePool::NodePool() : classes_(), class_count_(0) {}
+
+NodePool::~NodePool()
+{
+    for (void* slab : slabs_) ::operator delete(slab);
+}
+
+NodePool::SizeClass* NodePool::classFor(size_t bytes, bool create)
+{
+    size_t size = round_up(bytes);
+    for (size_t i = 0; i < class_count_; i++)
+    {
+        if (classes_[i].size == size) return &classes_[i];
+    }
+    if (!create || class_count_ == MAX_CLASSES || size > SLAB_BYTES / 4) return nullptr;
+    classes_[class_count_] = {size, nullptr};
+    return &classes_[class_count_++];
+}
+
+void NodePool::refill(SizeClass& size_class)
+{
+    size_t count = SLAB_BYTES / size_class.size;
+    char* slab = static_cast<char*>(::operator new(count * size_class.size));
+    slabs_.push_back(slab);
+    for (size_t i = count; i > 0; i--)
+    {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + (i - 1) * size_class.size);
+        block->next = size_class.free;
+        size_class.free = block;
+    }
+}
+
+void* NodePool::take(size_t bytes)
+{
+    SizeClass* size_class = classFor(bytes, true);
+    if (size_class == nullptr) return ::operator new(bytes);  // odd sizes: a deque's map growing
+    if (size_class->free == nullptr) refill(*size_class);
+    FreeBlock* block = size_class->free;
+    size_class->free = block->next;
+    return block;
+}
+
+void NodePool::give(void* block, size_t bytes)
+{
+    SizeClass* size_class = classFor(bytes, false);
+    if (size_class == nullptr)
+    {
+        ::operator delete(block);
+        return;
+    }
+    FreeBlock* free_block = static_cast<FreeBlock*>(block);
+    free_block->next = size_class->free;
+    size_class->free = free_block;
+}
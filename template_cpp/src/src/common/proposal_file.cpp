@@ -0,0 +1,96 @@
+#include "common/proposal_file.hpp"
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ProposalFile::ProposalFile(const std::string& path)
+    : data_(nullptr), size_(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open proposal file: " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat proposal file: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0)
+    {
+        void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to mmap proposal file: " + path);
+        }
+        //shots按顺序读取，让内核提前预读
+        ::madvise(mapped, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapped);
+    }
+    ::close(fd);
+}
+
+ProposalFile::~ProposalFile()
+{
+    if (data_ != nullptr)
+    {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+ProposalIterator::ProposalIterator(const ProposalFile& file)
+    : pos_(file.begin()), end_(file.end()), released_(file.begin())
+{
+    // skip the "p vs ds" header
+    if (pos_ != end_)
+    {
+        const void* newline = std::memchr(pos_, '\n', static_cast<size_t>(end_ - pos_));
+        pos_ = newline ? static_cast<const char*>(newline) + 1 : end_;
+    }
+}
+
+bool ProposalIterator::next(std::vector<uint32_t>& values)
+{
+    if (static_cast<size_t>(pos_ - released_) >= RELEASE_BYTES) releaseConsumed();
+    values.clear();
+    while (pos_ < end_)
+    {
+        char c = *pos_;
+        if (c == '\n')
+        {
+            pos_++;
+            if (!values.empty()) return true;
+            continue;
+        }
+        if (c >= '0' && c <= '9')
+        {
+            uint32_t value = 0;
+            auto result = std::from_chars(pos_, end_, value);
+            if (result.ec != std::errc())
+            {
+                throw std::runtime_error("Invalid value in proposal file");
+            }
+            values.push_back(value);
+            pos_ = result.ptr;
+            continue;
+        }
+        pos_++;  // separators, '\r'
+    }
+    return !values.empty();
+}
+
+void ProposalIterator::releaseConsumed()
+{
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t bytes = static_cast<size_t>(pos_ - released_) / page * page;
+    //只读的私有映射没有脏页，DONTNEED只是丢掉已经读过的页
+    ::madvise(const_cast<char*>(released_), bytes, MADV_DONTNEED);
+    released_ += bytes;
+}
@@ -0,0 +1,141 @@
+#include "common/runtime_options.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const char* env_or_null(const char* name) 
+{
+    const char* value = std::getenv(name);
+    return (value != nullptr && value[0] != '\0') ? value : nullptr;
+}
+
+static uint32_t env_uint(const char* name, uint32_t fallback, uint32_t min_value) 
+{
+    const char* value = env_or_null(name);
+    if (value == nullptr) return fallback;
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(value, &end, 10);
+    if (*end != '\0' || parsed < min_value || parsed > 0xFFFFFFFFul) 
+    {
+        std::cerr << "Ignoring invalid " << name << "=" << value << std::endl;
+        return fallback;
+    }
+    return static_cast<uint32_t>(parsed);
+}
+
+RuntimeOptions RuntimeOptions::fromEnv() 
+{
+    RuntimeOptions options;
+
+    if (const char* relay = env_or_null("DA_RELAY")) 
+    {
+        std::string mode(relay);
+        if (mode == "tree") 
+        {
+            options.relay_mode = RelayMode::TREE;
+        } 
+        else if (mode != "flood") 
+        {
+            std::cerr << "Ignoring unknown DA_RELAY=" << mode << std::endl;
+        }
+    }
+    options.relay_fanout = env_uint("DA_RELAY_FANOUT", options.relay_fanout, 1);
+
+    if (const char* repair = env_or_null("DA_REPAIR")) 
+    {
+        std::string mode(repair);
+        if (mode == "digest") 
+        {
+            options.repair_mode = RepairMode::DIGEST;
+            options.relay_mode = RelayMode::TREE;
+        } 
+        else if (mode != "ack") 
+        {
+            std::cerr << "Ignoring unknown DA_REPAIR=" << mode << std::endl;
+        }
+    }
+
+    options.lattice_pipeline = env_uint("DA_LA_PIPELINE", options.lattice_pipeline, 1);
+
+    if (const char* metrics = env_or_null("DA_METRICS")) 
+    {
+        std::string mode(metrics);
+        if (mode == "off") 
+        {
+            options.metrics_enabled = false;
+        } 
+        else if (mode != "on") 
+        {
+            std::cerr << "Ignoring unknown DA_METRICS=" << mode << std::endl;
+        }
+    }
+    options.metrics_interval_ms = env_uint("DA_METRICS_INTERVAL", options.metrics_interval_ms, 0);
+    options.trace_sample = env_uint("DA_TRACE", options.trace_sample, 0);
+
+    if (const char* capture = env_or_null("DA_CAPTURE")) 
+    {
+        std::string mode(capture);
+        if (mode == "on") 
+        {
+            options.capture_enabled = true;
+        } 
+        else if (mode != "off") 
+        {
+            std::cerr << "Ignoring unknown DA_CAPTURE=" << mode << std::endl;
+        }
+    }
+
+    if (const char* log = env_or_null("DA_LOG")) 
+    {
+        std::string mode(log);
+        if (mode == "ranges") 
+        {
+            options.log_format = LogFormat::RANGES;
+        } 
+        else if (mode != "text") 
+        {
+            std::cerr << "Ignoring unknown DA_LOG=" << mode << std::endl;
+        }
+    }
+
+    options.busy_poll_us = env_uint("DA_BUSY_POLL", options.busy_poll_us, 0);
+
+    if (const char* threads = env_or_null("DA_THREADS")) 
+    {
+        if (!ThreadPlacement::parse(threads, options.thread_placement)) 
+        {
+            std::cerr << "Ignoring invalid DA_THREADS=" << threads << std::endl;
+        }
+    }
+    uint32_t busy_poll_cpu = env_uint("DA_BUSY_POLL_CPU", NO_CPU, 0);
+    std::vector<uint32_t>& receive_cpus = options.thread_placement.cpus[static_cast<size_t>(ThreadRole::RECEIVE)];
+    if (busy_poll_cpu != NO_CPU && receive_cpus.empty()) receive_cpus.assign(1, busy_poll_cpu);
+
+    options.payload_bytes = env_uint("DA_PAYLOAD", options.payload_bytes, 0);
+    if (options.payload_bytes > MAX_PAYLOAD_BYTES) 
+    {
+        std::cerr << "Ignoring invalid DA_PAYLOAD=" << options.payload_bytes << std::endl;
+        options.payload_bytes = 0;
+    }
+    if (options.payload_bytes > 0 && options.relay_mode != RelayMode::FLOOD) 
+    {
+        std::cerr << "Ignoring DA_PAYLOAD: bodies are only relayed with DA_RELAY=flood" << std::endl;
+        options.payload_bytes = 0;
+    }
+
+    if (const char* gso = env_or_null("DA_GSO")) 
+    {
+        std::string mode(gso);
+        if (mode == "off") 
+        {
+            options.segmentation_offload = false;
+        } 
+        else if (mode != "on") 
+        {
+            std::cerr << "Ignoring unknown DA_GSO=" << mode << std::endl;
+        }
+    }
+
+    return options;
+}
@@ -1,10 +1,27 @@
 #include "common/signal_handler.hpp"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
 #include <csignal>
+#include <ctime>
+#include <stdexcept>
 
 std::atomic<bool> SignalHandler::stop_flag_(false);
+std::atomic<int64_t> SignalHandler::stop_time_ns_(0);
+int SignalHandler::event_fd_ = -1;
+
+static_assert(std::atomic<int64_t>::is_always_lock_free, "stop_time_ns_ is written in a signal handler");
 
 void SignalHandler::setup() 
 {
+    if (event_fd_ < 0) 
+    {
+        event_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (event_fd_ < 0) 
+        {
+            throw std::runtime_error("Failed to create eventfd");
+        }
+    }
     std::signal(SIGTERM, SignalHandler::handleSignal);
     std::signal(SIGINT, SignalHandler::handleSignal);
 }
@@ -14,9 +31,46 @@ bool SignalHandler::shouldStop()
     return stop_flag_.load();
 }
 
+void SignalHandler::waitForStop() 
+{
+    uint64_t value;
+    //eventfd的read会阻塞直到handleSignal或wake写入
+    while (read(event_fd_, &value, sizeof(value)) < 0 && errno == EINTR) 
+    {
+    }
+}
+
+void SignalHandler::wake() 
+{
+    markStopTime();
+    uint64_t one = 1;
+    ssize_t written = write(event_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+std::chrono::steady_clock::time_point SignalHandler::stopRequestedAt() 
+{
+    int64_t ns = stop_time_ns_.load();
+    if (ns == 0) return std::chrono::steady_clock::now();
+    return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(ns));
+}
+
+// steady_clock is CLOCK_MONOTONIC on Linux; clock_gettime is async-signal-safe, now() is not
+// guaranteed to be.
+void SignalHandler::markStopTime() 
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t expected = 0;
+    stop_time_ns_.compare_exchange_strong(expected, static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec);
+}
+
 void SignalHandler::handleSignal(int signal) 
 {
+    int saved_errno = errno;
     stop_flag_.store(true);
+    wake();
     std::signal(SIGTERM, SIG_DFL);
     std::signal(SIGINT, SIG_DFL);
-}
\ No newline at end of file
+    errno = saved_errno;
+}
@@ -0,0 +1,136 @@
+#include "common/threads.hpp"
+#include "common/metrics.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <cstdlib>
+#include <sstream>
+
+static const char* const ROLE_NAMES[THREAD_ROLES] = {
+    "recv",
+    "flush",
+    "send",
+    "retx",
+    "digest",
+    "flow",
+};
+
+const char* threadRoleName(ThreadRole role)
+{
+    return ROLE_NAMES[static_cast<size_t>(role)];
+}
+
+bool pinCurrentThread(uint32_t cpu)
+{
+    if (cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// ======================
+// ThreadPlacement
+// ======================
+
+static bool parse_cpu(const std::string& text, uint32_t& cpu)
+{
+    if (text.empty()) return false;
+    char* end = nullptr;
+    unsigned long value = std::strtoul(text.c_str(), &end, 10);
+    if (*end != '\0' || value >= CPU_SETSIZE) return false;
+    cpu = static_cast<uint32_t>(value);
+    return true;
+}
+
+// "c" or "a-b"
+static bool parse_cpus(const std::string& text, std::vector<uint32_t>& cpus)
+{
+    size_t dash = text.find('-');
+    uint32_t first = 0;
+    uint32_t last = 0;
+    if (dash == std::string::npos)
+    {
+        if (!parse_cpu(text, first)) return false;
+        last = first;
+    }
+    else if (!parse_cpu(text.substr(0, dash), first) || !parse_cpu(text.substr(dash + 1), last) || last < first)
+    {
+        return false;
+    }
+    cpus.clear();
+    for (uint32_t cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    return true;
+}
+
+bool ThreadPlacement::parse(const std::string& spec, ThreadPlacement& out)
+{
+    ThreadPlacement placement;
+    std::vector<uint32_t> fallback;
+    std::istringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        if (item == "colocate")
+        {
+            placement.colocate = true;
+            continue;
+        }
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string role = item.substr(0, eq);
+        std::vector<uint32_t> cpus;
+        if (!parse_cpus(item.substr(eq + 1), cpus)) return false;
+        if (role == "default")
+        {
+            fallback = cpus;
+            continue;
+        }
+        size_t r = 0;
+        while (r < THREAD_ROLES && role != ROLE_NAMES[r]) r++;
+        if (r == THREAD_ROLES) return false;
+        placement.cpus[r] = cpus;
+    }
+    for (auto& cpus : placement.cpus)
+    {
+        if (cpus.empty()) cpus = fallback;
+    }
+    out = placement;
+    return true;
+}
+
+uint32_t ThreadPlacement::cpuFor(ThreadRole role, uint32_t peer_index) const
+{
+    if (colocate && role == ThreadRole::RETRANSMIT) role = ThreadRole::SEND;
+    const std::vector<uint32_t>& list = cpus[static_cast<size_t>(role)];
+    if (list.empty()) return NO_CPU;
+    return list[peer_index == NO_PEER ? 0 : peer_index % list.size()];
+}
+
+bool ThreadPlacement::empty() const
+{
+    for (const auto& list : cpus)
+    {
+        if (!list.empty()) return false;
+    }
+    return true;
+}
+
+// ======================
+// ThreadScope
+// ======================
+
+ThreadScope::ThreadScope(const ThreadPlacement& placement, ThreadRole role, uint32_t peer_index, uint32_t peer_id)
+{
+    std::string name = threadRoleName(role);
+    if (peer_index != NO_PEER) name += "." + std::to_string(peer_id);
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());  // kernel limit: 15 + NUL
+
+    uint32_t cpu = placement.cpuFor(role, peer_index);
+    bool pinned = cpu == NO_CPU || pinCurrentThread(cpu);
+    metrics::attachThreadUsage(name, cpu, pinned);
+}
+
+ThreadScope::~ThreadScope()
+{
+    metrics::detachThreadUsage();
+}
@@ -1,43 +1,98 @@
 #include "fifobroadcast/fifo_broadcast_app.hpp"
-#include <iostream>
+#include "common/metrics.hpp"
+#include "common/threads.hpp"
+#include "common/tracepoints.hpp"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
 
 namespace milestone2 {
 
+// DA_PAYLOAD bodies: a byte pattern that depends on (origin, seq), so that a receiver can
+// tell each message arrived with its own body.
+static uint8_t payload_byte(uint32_t origin, uint32_t seq, size_t i) {
+    return static_cast<uint8_t>(origin * 131u + seq * 7u + static_cast<uint32_t>(i));
+}
+
+static SharedPayload make_payload(uint32_t origin, uint32_t seq, uint32_t bytes) {
+    std::vector<uint8_t> body(bytes);
+    for (size_t i = 0; i < body.size(); i++) body[i] = payload_byte(origin, seq, i);
+    return std::make_shared<const std::vector<uint8_t>>(std::move(body));
+}
+
+static bool payload_matches(uint32_t origin, uint32_t seq, uint32_t bytes, const std::vector<uint8_t>& body) {
+    if (body.size() != bytes) return false;
+    for (size_t i = 0; i < body.size(); i++) {
+        if (body[i] != payload_byte(origin, seq, i)) return false;
+    }
+    return true;
+}
+
 FIFOBroadcastApp::FIFOBroadcastApp(uint32_t my_id, const std::vector<Host>& hosts,
-                                   uint32_t m, const std::string& output_path)
-    : my_id_(my_id), hosts_(hosts), m_(m), running_(false) {
+                                   uint32_t m, const std::string& output_path,
+                                   const RuntimeOptions& options, Transport* transport)
+    : my_id_(my_id), peers_(hosts), my_index_(peers_.indexOfId(my_id)), m_(m), options_(options),
+      relay_tree_(static_cast<uint32_t>(peers_.size()), my_index_, options.relay_fanout),
+      running_(false) {
     
-    n_processes_ = hosts_.size();
+    n_processes_ = static_cast<uint32_t>(peers_.size());
     majority_ = n_processes_ / 2 + 1;
     
-    Host my_host = findHost(my_id_);
-    receiver_socket_ = new UDPSocket(my_host.port);
-    sender_socket_ = new UDPSocket(static_cast<uint16_t>(my_host.port + 1000));
+    if (my_index_ == PeerDirectory::INVALID_INDEX) {
+        throw std::runtime_error("Process id not found in hosts file");
+    }
+    const Host& my_host = peers_.at(my_index_).host;
+    socket_ = transport;
+    if (!socket_) {
+        UDPSocket* udp = new UDPSocket(my_host.port);
+        udp->setBusyPoll(options_.busy_poll_us);
+        udp->setSegmentationOffload(options_.segmentation_offload);
+        socket_ = udp;
+    }
     
-    logger_ = new Logger(output_path);
+    logger_ = new Logger(output_path, options_.log_format);
+    tracer_ = options_.trace_sample > 0 ? new LatencyTracer(options_.trace_sample) : nullptr;
+    capture_ = options_.capture_enabled ? new PacketCaptureWriter(output_path + ".capture", my_id_, peers_) : nullptr;
     
-    for (const Host& host : hosts_) {
-        if (host.id != my_id_) {
-            senders_[host.id] = new milestone1::Sender(sender_socket_, my_id_, host, logger_);
+    // Links neither log nor dedupe here: broadcast/delivery events are logged by the URB/FIFO
+    // layer. ACKs for a peer ride on the DATA we send back to it whenever possible.
+    receiver_ = new milestone1::Receiver(socket_, peers_, nullptr, true);
+    receiver_->setPlacement(options_.thread_placement);
+    
+    // DIGEST repair mode relays without per-message Senders.
+    senders_.assign(peers_.size(), nullptr);
+    for (const Peer& peer : peers_.peers()) {
+        if (peer.id != my_id_ && options_.repair_mode == RepairMode::LINK_ACK) {
+            senders_[peer.index] = new milestone1::Sender(socket_, my_id_, peer, nullptr, receiver_, tracer_);
+            senders_[peer.index]->setPlacement(options_.thread_placement);
         }
     }
     
-    receiver_ = new milestone1::Receiver(receiver_socket_, logger_);
+    for (const Peer& peer : peers_.peers()) {
+        next_[peer.id] = 1;
+    }
     
-    for (const Host& host : hosts_) {
-        next_[host.id] = 1;
+    if (options_.relay_mode == RelayMode::TREE) {
+        have_.assign(n_processes_, 0);
+        have_above_.resize(n_processes_);
+        peer_have_.assign(n_processes_, std::vector<uint32_t>(n_processes_, 0));
+        peer_gaps_.assign(n_processes_, std::vector<uint64_t>(n_processes_, 0));
+        repaired_.assign(n_processes_, std::vector<uint32_t>(n_processes_, 0));
+        last_repair_.assign(n_processes_,
+                            std::vector<std::chrono::steady_clock::time_point>(n_processes_));
     }
 }
 
 FIFOBroadcastApp::~FIFOBroadcastApp() {
     shutdown();
-    for (auto& [id, sender] : senders_) {
+    for (milestone1::Sender* sender : senders_) {
         delete sender;
     }
     delete receiver_;
     delete logger_;
-    delete sender_socket_;
-    delete receiver_socket_;
+    delete tracer_;
+    delete capture_;
+    delete socket_;
 }
 
 void FIFOBroadcastApp::run() {
@@ -46,12 +101,21 @@ void FIFOBroadcastApp::run() {
     receive_thread_ = std::thread(&FIFOBroadcastApp::receiveLoop, this);
     receiver_->start();
     
-    for (auto& [id, sender] : senders_) {
-        sender->start();
+    for (milestone1::Sender* sender : senders_) {
+        if (sender) sender->start();
     }
     
-    for (uint32_t seq = 1; seq <= m_; seq++) {
-        urbBroadcast(my_id_, seq);
+    if (options_.relay_mode == RelayMode::TREE) {
+        digest_thread_ = std::thread(&FIFOBroadcastApp::digestLoop, this);
+        for (uint32_t seq = 1; seq <= m_; seq += RELAY_BATCH) {
+            treeBroadcast(seq, std::min(m_, seq + RELAY_BATCH - 1));
+        }
+    } else {
+        for (uint32_t seq = 1; seq <= m_; seq++) {
+            SharedPayload payload;
+            if (options_.payload_bytes > 0) payload = make_payload(my_id_, seq, options_.payload_bytes);
+            urbBroadcast(my_id_, seq, payload);
+        }
     }
     
     logger_->flush();
@@ -60,27 +124,30 @@ void FIFOBroadcastApp::run() {
 void FIFOBroadcastApp::shutdown() {
     running_ = false;
     
-    receiver_socket_->close();
-    sender_socket_->close();
-    
+    // Stop the link threads before closing the socket they send on.
+    if (digest_thread_.joinable()) digest_thread_.join();
     receiver_->stop();
-    for (auto& [id, sender] : senders_) {
-        sender->stop();
+    for (milestone1::Sender* sender : senders_) {
+        if (sender) sender->stop();
     }
     
-    if (receive_thread_.joinable()) receive_thread_.detach();
+    socket_->close();
     
-    logger_->flush();
+    if (receive_thread_.joinable()) receive_thread_.join();
+    
+    logger_->close();
 }
 
-void FIFOBroadcastApp::urbBroadcast(uint32_t sender_id, uint32_t seq) {
+void FIFOBroadcastApp::urbBroadcast(uint32_t sender_id, uint32_t seq, const SharedPayload& payload) {
     MessageId msg_id = {sender_id, seq};
     
     {
         std::lock_guard<std::mutex> lock(receiver_state_mutex_);
         
         if (sender_id == my_id_) {
+            DA_PROBE2(broadcast, my_id_, seq);
             logger_->logBroadcast(seq);
+            if (tracer_) tracer_->stampBroadcast(my_id_, seq);
         }
         
         forwarded_.insert(msg_id);
@@ -91,8 +158,8 @@ void FIFOBroadcastApp::urbBroadcast(uint32_t sender_id, uint32_t seq) {
         }
     }
     
-    for (auto& [target_id, sender] : senders_) {
-        sender->send(sender_id, seq);
+    for (milestone1::Sender* sender : senders_) {
+        if (sender) sender->send(sender_id, seq, payload);
     }
     
     {
@@ -103,6 +170,7 @@ void FIFOBroadcastApp::urbBroadcast(uint32_t sender_id, uint32_t seq) {
         if (urb_ack_list_[msg_id].size() >= majority_) {
             urb_delivered_.insert(msg_id);
             urb_ack_list_.erase(msg_id);
+            if (tracer_) tracer_->urbDelivered(sender_id, seq);
             
             fifoDeliver(sender_id, seq);
         }
@@ -110,26 +178,53 @@ void FIFOBroadcastApp::urbBroadcast(uint32_t sender_id, uint32_t seq) {
 }
 
 void FIFOBroadcastApp::receiveLoop() {
+    // Only the receive path spins here: n-1 Senders spinning at once would eat the CPUs the
+    // receive thread is meant to own.
+    ThreadScope scope(options_.thread_placement, ThreadRole::RECEIVE);
+    std::vector<uint8_t> data;
+    sockaddr_in sender_addr;
     while (running_) {
         try {
-            auto [data, sender_ip, sender_port] = receiver_socket_->receive();
-            Packet packet = Packet::deserialize(data);
-            if (packet.type == MessageType::PERFECT_LINK_DATA) {
-                handlePacket(packet, sender_ip, sender_port);
-            }
+            socket_->receive(data, sender_addr);
+            if (capture_) capture_->record(sender_addr, data);
+            handleDatagram(data, sender_addr);
         } catch (const std::exception&) {
             if (!running_) break;
         }
     }
 }
 
-void FIFOBroadcastApp::handlePacket(const Packet& packet, const std::string& sender_ip, uint16_t sender_port) {
-    uint32_t udp_source_id = getProcessIdFromAddress(sender_ip, sender_port);
+void FIFOBroadcastApp::handleDatagram(const std::vector<uint8_t>& data, const sockaddr_in& sender_addr) {
+    uint32_t peer_index = peers_.lookup(sender_addr);
+    if (peer_index == PeerDirectory::INVALID_INDEX) return;
+    metrics::addPeer(metrics::PeerCounter::PACKETS_RECEIVED, peer_index);
+
+    Packet packet = Packet::deserialize(data);
+    if (packet.type == MessageType::BROADCAST_DATA || packet.type == MessageType::BROADCAST_PAYLOAD) {
+        if (options_.relay_mode == RelayMode::TREE) {
+            handleTreePacket(packet, peer_index);
+        } else {
+            handlePacket(packet, peer_index);
+        }
+    } else if (packet.type == MessageType::BROADCAST_DIGEST) {
+        handleDigest(packet, peer_index);
+    } else if (packet.type == MessageType::BROADCAST_ACK && senders_[peer_index]) {
+        senders_[peer_index]->handleAck(packet);
+    }
+}
+
+void FIFOBroadcastApp::handlePacket(const Packet& packet, uint32_t peer_index) {
+    uint32_t udp_source_id = peers_.at(peer_index).id;
     uint32_t original_sender = packet.sender_id;
     
-    receiver_->handle(packet, sender_ip, sender_port);
+    if (!packet.acks.empty() && senders_[peer_index]) {
+        senders_[peer_index]->handleAck(packet);
+    }
+    receiver_->handle(packet, peer_index);
+    if (tracer_) tracer_->learnStamps(original_sender, packet.stamps);
     
-    for (uint32_t seq : packet.seq_numbers) {
+    for (size_t i = 0; i < packet.seq_numbers.size(); i++) {
+        uint32_t seq = packet.seq_numbers[i];
         MessageId msg_id = {original_sender, seq};
         
         bool should_forward = false;
@@ -150,12 +245,19 @@ void FIFOBroadcastApp::handlePacket(const Packet& packet, const std::string& sen
                 urb_delivered_.insert(msg_id);
                 urb_ack_list_.erase(msg_id);
                 should_deliver = true;
+                if (tracer_) tracer_->urbDelivered(original_sender, seq);
             }
         }
         
         if (should_forward) {
-            for (auto& [target_id, sender] : senders_) {
-                sender->send(original_sender, seq);
+            // The decoded body is the only copy in this process: every Sender relays it by reference.
+            SharedPayload payload = i < packet.payloads.size() ? packet.payloads[i] : nullptr;
+            if (options_.payload_bytes > 0 &&
+                (payload == nullptr || !payload_matches(original_sender, seq, options_.payload_bytes, *payload))) {
+                metrics::add(metrics::Counter::PAYLOAD_MISMATCHES);
+            }
+            for (milestone1::Sender* sender : senders_) {
+                if (sender) sender->send(original_sender, seq, payload);
             }
         }
         
@@ -168,33 +270,258 @@ void FIFOBroadcastApp::handlePacket(const Packet& packet, const std::string& sen
 
 void FIFOBroadcastApp::fifoDeliver(uint32_t sender_id, uint32_t seq) {
     if (seq == next_[sender_id]) {
+        DA_PROBE2(fifo_deliver, sender_id, seq);
         logger_->logDelivery(sender_id, seq);
+        if (tracer_) tracer_->fifoDelivered(sender_id, seq);
         next_[sender_id]++;
         
-        while (pending_[sender_id].count(next_[sender_id])) {
-            uint32_t next_seq = next_[sender_id];
-            logger_->logDelivery(sender_id, next_seq);
-            pending_[sender_id].erase(next_seq);
+        std::map<uint32_t, std::chrono::steady_clock::time_point>& held = pending_[sender_id];
+        if (held.empty()) return;
+        auto now = std::chrono::steady_clock::now();
+        while (!held.empty() && held.begin()->first == next_[sender_id]) {
+            DA_PROBE2(fifo_deliver, sender_id, next_[sender_id]);
+            logger_->logDelivery(sender_id, next_[sender_id]);
+            if (tracer_) tracer_->fifoDelivered(sender_id, next_[sender_id]);
+            metrics::record(metrics::Histogram::FIFO_HOLDBACK_US, metrics::microsSince(held.begin()->second, now));
+            held.erase(held.begin());
             next_[sender_id]++;
         }
     } else {
-        pending_[sender_id][seq] = {sender_id, seq};
+        pending_[sender_id][seq] = std::chrono::steady_clock::now();
+    }
+}
+
+// ======================
+// TREE relay mode
+// ======================
+
+void FIFOBroadcastApp::treeBroadcast(uint32_t first_seq, uint32_t last_seq) {
+    std::vector<uint32_t> seqs;
+    {
+        std::lock_guard<std::mutex> lock(receiver_state_mutex_);
+        for (uint32_t seq = first_seq; seq <= last_seq; seq++) {
+            DA_PROBE2(broadcast, my_id_, seq);
+            logger_->logBroadcast(seq);
+            if (tracer_) tracer_->stampBroadcast(my_id_, seq);
+            markReceived(my_index_, seq);
+            seqs.push_back(seq);
+        }
+        deliverStable(my_index_);
+    }
+    for (uint32_t child : relay_tree_.children(my_index_)) {
+        relay(child, my_id_, seqs);
     }
 }
 
-Host FIFOBroadcastApp::findHost(uint32_t id) const {
-    for (const Host& host : hosts_) {
-        if (host.id == id) return host;
+void FIFOBroadcastApp::handleTreePacket(const Packet& packet, uint32_t peer_index) {
+    if (options_.repair_mode == RepairMode::LINK_ACK) {
+        if (!packet.acks.empty() && senders_[peer_index]) {
+            senders_[peer_index]->handleAck(packet);
+        }
+        receiver_->handle(packet, peer_index);
+    }
+    
+    uint32_t origin_index = peers_.indexOfId(packet.sender_id);
+    if (origin_index == PeerDirectory::INVALID_INDEX) return;
+    if (tracer_) tracer_->learnStamps(packet.sender_id, packet.stamps);
+    
+    std::vector<uint32_t> fresh;
+    {
+        std::lock_guard<std::mutex> lock(receiver_state_mutex_);
+        for (uint32_t seq : packet.seq_numbers) {
+            if (markReceived(origin_index, seq)) fresh.push_back(seq);
+        }
+        deliverStable(origin_index);
+    }
+    
+    // Repairs arrive from non-parents too; forwarding them covers a subtree cut off by a failure.
+    if (fresh.empty()) return;
+    for (uint32_t child : relay_tree_.children(origin_index)) {
+        relay(child, packet.sender_id, fresh);
     }
-    return Host();
 }
 
-uint32_t FIFOBroadcastApp::getProcessIdFromAddress(const std::string& ip, uint16_t port) const {
-    uint16_t base_port = port >= 12000 ? port - 1000 : port;
-    for (const Host& host : hosts_) {
-        if (host.port == base_port) return host.id;
+void FIFOBroadcastApp::handleDigest(const Packet& packet, uint32_t peer_index) {
+    if (options_.relay_mode != RelayMode::TREE) return;
+    
+    std::lock_guard<std::mutex> lock(receiver_state_mutex_);
+    for (const DigestEntry& entry : packet.digest) {
+        uint32_t origin_index = peers_.indexOfId(entry.origin);
+        if (origin_index == PeerDirectory::INVALID_INDEX) continue;
+        uint32_t& watermark = peer_have_[peer_index][origin_index];
+        if (entry.watermark < watermark) continue;  // reordered, stale digest
+        peer_gaps_[peer_index][origin_index] = entry.received_above;
+        if (entry.watermark > watermark) {
+            watermark = entry.watermark;
+            deliverStable(origin_index);
+        }
+    }
+}
+
+// LINK_ACK: hand the messages to the peer's Sender. DIGEST: send them once, unacknowledged.
+void FIFOBroadcastApp::relay(uint32_t peer_index, uint32_t origin_id, const std::vector<uint32_t>& seqs) {
+    if (options_.repair_mode == RepairMode::LINK_ACK) {
+        for (uint32_t seq : seqs) {
+            senders_[peer_index]->send(origin_id, seq);
+        }
+        return;
+    }
+    for (size_t i = 0; i < seqs.size(); i += RELAY_BATCH) {
+        std::vector<uint32_t> batch(seqs.begin() + static_cast<std::ptrdiff_t>(i),
+                                    seqs.begin() + static_cast<std::ptrdiff_t>(std::min(seqs.size(), i + RELAY_BATCH)));
+        Packet packet = Packet::createDataPacket(origin_id, batch);
+        packet.type = MessageType::BROADCAST_DATA;
+        if (tracer_) tracer_->attachStamps(origin_id, batch, packet.stamps);
+        socket_->send(peers_.at(peer_index).addr, packet.serialize());
+    }
+}
+
+// caller holds receiver_state_mutex_; returns true the first time (origin, seq) is seen
+bool FIFOBroadcastApp::markReceived(uint32_t origin_index, uint32_t seq) {
+    uint32_t& watermark = have_[origin_index];
+    std::set<uint32_t>& above = have_above_[origin_index];
+    if (seq <= watermark || above.count(seq)) return false;
+    
+    if (seq == watermark + 1) {
+        watermark++;
+        while (!above.empty() && *above.begin() == watermark + 1) {
+            above.erase(above.begin());
+            watermark++;
+        }
+    } else {
+        above.insert(seq);
+    }
+    return true;
+}
+
+// caller holds receiver_state_mutex_. A message is URB-deliverable once a majority of
+// processes (self included) report it below their watermark; watermarks make this FIFO too.
+void FIFOBroadcastApp::deliverStable(uint32_t origin_index) {
+    std::vector<uint32_t> watermarks(n_processes_);
+    for (uint32_t q = 0; q < n_processes_; q++) {
+        watermarks[q] = q == my_index_ ? have_[origin_index] : peer_have_[q][origin_index];
+    }
+    std::nth_element(watermarks.begin(), watermarks.begin() + (majority_ - 1), watermarks.end(),
+                     std::greater<uint32_t>());
+    uint32_t stable = std::min(watermarks[majority_ - 1], have_[origin_index]);
+    
+    uint32_t origin_id = peers_.at(origin_index).id;
+    uint32_t& next = next_[origin_id];
+    while (next <= stable) {
+        DA_PROBE2(fifo_deliver, origin_id, next);
+        logger_->logDelivery(origin_id, next);
+        if (tracer_) tracer_->fifoDelivered(origin_id, next);
+        next++;
+    }
+}
+
+// caller holds receiver_state_mutex_
+DigestEntry FIFOBroadcastApp::digestEntry(uint32_t origin_index) const {
+    DigestEntry entry;
+    entry.origin = peers_.at(origin_index).id;
+    entry.watermark = have_[origin_index];
+    entry.received_above = 0;
+    const std::set<uint32_t>& above = have_above_[origin_index];
+    for (auto it = above.begin(); it != above.end() && *it - entry.watermark <= DigestEntry::GAP_BITS; ++it) {
+        entry.received_above |= 1ull << (*it - entry.watermark - 1);
+    }
+    return entry;
+}
+
+// caller holds receiver_state_mutex_; newest have_ snapshot at least `age` old, if any
+const std::vector<uint32_t>* FIFOBroadcastApp::agedHave(std::chrono::steady_clock::time_point now,
+                                                        std::chrono::milliseconds age) const {
+    for (auto it = have_history_.rbegin(); it != have_history_.rend(); ++it) {
+        if (it->first <= now - age) return &it->second;
+    }
+    return nullptr;
+}
+
+// caller holds receiver_state_mutex_; seqs in (peer watermark, limit] the peer's digest lacks
+void FIFOBroadcastApp::collectGaps(uint32_t peer_index, uint32_t origin_index, uint32_t limit,
+                                   std::vector<uint32_t>& out) const {
+    uint32_t watermark = peer_have_[peer_index][origin_index];
+    uint64_t gaps = peer_gaps_[peer_index][origin_index];
+    for (uint32_t seq = watermark + 1; seq <= limit && out.size() < REPAIR_BUDGET; seq++) {
+        uint32_t bit = seq - watermark - 1;
+        if (bit < DigestEntry::GAP_BITS && (gaps >> bit) & 1ull) continue;
+        out.push_back(seq);
+    }
+}
+
+// Every DIGEST_INTERVAL: send our watermark digest to all peers, then repair.
+// LINK_ACK: push once (via the reliable Sender) whatever a peer still lacks that we have held
+//           for SUSPECT_TIMEOUT; its tree path is presumed broken.
+// DIGEST:   resend the gaps a peer's digest shows, at most every REPAIR_INTERVAL per origin,
+//           for children we relay to (after a REPAIR_INTERVAL grace) and, past SUSPECT_TIMEOUT,
+//           for anyone.
+void FIFOBroadcastApp::digestLoop() {
+    ThreadScope scope(options_.thread_placement, ThreadRole::DIGEST);
+    struct Repair {
+        uint32_t peer_index;
+        uint32_t origin_id;
+        std::vector<uint32_t> seqs;
+    };
+    
+    while (running_) {
+        std::this_thread::sleep_for(DIGEST_INTERVAL);
+        
+        std::vector<DigestEntry> digest;
+        std::vector<Repair> repairs;
+        {
+            std::lock_guard<std::mutex> lock(receiver_state_mutex_);
+            for (uint32_t o = 0; o < n_processes_; o++) {
+                digest.push_back(digestEntry(o));
+            }
+            
+            auto now = std::chrono::steady_clock::now();
+            have_history_.push_back({now, have_});
+            while (have_history_.size() >= 2 && have_history_[1].first <= now - SUSPECT_TIMEOUT) {
+                have_history_.pop_front();
+            }
+            const std::vector<uint32_t>* suspect = agedHave(now, SUSPECT_TIMEOUT);
+            const std::vector<uint32_t>* grace = agedHave(now, REPAIR_INTERVAL);
+            
+            for (uint32_t o = 0; o < n_processes_; o++) {
+                uint32_t origin_id = peers_.at(o).id;
+                if (options_.repair_mode == RepairMode::LINK_ACK) {
+                    if (suspect == nullptr) continue;
+                    for (uint32_t q = 0; q < n_processes_; q++) {
+                        uint32_t from = std::max(peer_have_[q][o], repaired_[q][o]);
+                        if (q == my_index_ || (*suspect)[o] <= from) continue;
+                        Repair repair{q, origin_id, {}};
+                        for (uint32_t seq = from + 1; seq <= (*suspect)[o]; seq++) repair.seqs.push_back(seq);
+                        repairs.push_back(std::move(repair));
+                        repaired_[q][o] = (*suspect)[o];
+                    }
+                    continue;
+                }
+                
+                const std::vector<uint32_t>& children = relay_tree_.children(o);
+                for (uint32_t q = 0; q < n_processes_; q++) {
+                    if (q == my_index_ || now - last_repair_[q][o] < REPAIR_INTERVAL) continue;
+                    uint32_t limit = suspect ? (*suspect)[o] : 0;
+                    if (grace && std::find(children.begin(), children.end(), q) != children.end()) {
+                        limit = std::max(limit, (*grace)[o]);
+                    }
+                    if (limit <= peer_have_[q][o]) continue;
+                    Repair repair{q, origin_id, {}};
+                    collectGaps(q, o, limit, repair.seqs);
+                    if (repair.seqs.empty()) continue;
+                    repairs.push_back(std::move(repair));
+                    last_repair_[q][o] = now;
+                }
+            }
+        }
+        
+        std::vector<uint8_t> bytes = Packet::createDigestPacket(digest).serialize();
+        for (const Peer& peer : peers_.peers()) {
+            if (peer.index != my_index_) socket_->send(peer.addr, bytes);
+        }
+        for (const Repair& repair : repairs) {
+            relay(repair.peer_index, repair.origin_id, repair.seqs);
+        }
     }
-    return 0;
 }
 
 }
@@ -0,0 +1,15 @@
+#include "fifobroadcast/relay_tree.hpp"
+
+namespace milestone2 {
+
+RelayTree::RelayTree(uint32_t n, uint32_t my_index, uint32_t fanout) : children_(n) {
+    for (uint32_t origin = 0; origin < n; origin++) {
+        uint64_t my_rank = (my_index + n - origin) % n;
+        for (uint64_t child_rank = my_rank * fanout + 1;
+             child_rank <= my_rank * fanout + fanout && child_rank < n; child_rank++) {
+            children_[origin].push_back(static_cast<uint32_t>((origin + child_rank) % n));
+        }
+    }
+}
+
+}
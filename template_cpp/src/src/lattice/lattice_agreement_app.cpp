@@ -0,0 +1,356 @@
+#include "lattice/lattice_agreement_app.hpp"
+#include "common/metrics.hpp"
+#include "common/threads.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace milestone3 {
+
+LatticeAgreementApp::LatticeAgreementApp(uint32_t my_id, const std::vector<Host>& hosts,
+                                         const LatticeAgreementConfig& config,
+                                         const std::string& output_path,
+                                         const RuntimeOptions& options)
+    : my_id_(my_id), peers_(hosts), my_index_(peers_.indexOfId(my_id)), config_(config),
+      proposal_file_(config.path), proposal_iter_(proposal_file_), shots_(config.proposals),
+      options_(options), universe_(config.distinct_values, config.max_values),
+      next_shot_(0), next_logged_(0), announced_(0), gc_floor_(0), running_(false) {
+
+    if (my_index_ == PeerDirectory::INVALID_INDEX) {
+        throw std::runtime_error("Process id not found in hosts file");
+    }
+    n_processes_ = static_cast<uint32_t>(peers_.size());
+    majority_ = n_processes_ / 2 + 1;
+
+    socket_ = new UDPSocket(peers_.at(my_index_).host.port);
+    socket_->setSegmentationOffload(options_.segmentation_offload);
+    logger_ = new Logger(output_path);
+
+    // The links only ACK; dedupe happens here, per peer, over the payload seqs.
+    receiver_ = new milestone1::Receiver(socket_, peers_, nullptr);
+    receiver_->setPlacement(options_.thread_placement);
+    link_watermark_.assign(peers_.size(), 0);
+    link_above_.resize(peers_.size());
+    outbox_.resize(peers_.size());
+    decided_through_.assign(peers_.size(), 0);
+    progressed_.resize(peers_.size());
+    senders_.assign(peers_.size(), nullptr);
+    for (const Peer& peer : peers_.peers()) {
+        if (peer.index != my_index_) {
+            senders_[peer.index] = new milestone1::Sender(socket_, my_id_, peer, nullptr);
+            senders_[peer.index]->setPlacement(options_.thread_placement);
+        }
+    }
+}
+
+LatticeAgreementApp::~LatticeAgreementApp() {
+    shutdown();
+    for (milestone1::Sender* sender : senders_) {
+        delete sender;
+    }
+    delete receiver_;
+    delete logger_;
+    delete socket_;
+}
+
+void LatticeAgreementApp::run() {
+    running_ = true;
+    start_time_ = std::chrono::steady_clock::now();
+    progressed_.assign(peers_.size(), start_time_);
+
+    receive_thread_ = std::thread(&LatticeAgreementApp::receiveLoop, this);
+    flow_thread_ = std::thread(&LatticeAgreementApp::flowLoop, this);
+    receiver_->start();
+    for (milestone1::Sender* sender : senders_) {
+        if (sender) sender->start();
+    }
+
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    startShots();
+    drainLoopback();
+    flushOutbox();
+}
+
+void LatticeAgreementApp::shutdown() {
+    {
+        // A handler in progress finishes first; later ones see !running_ and leave the
+        // state (and the senders/logger the destructor is about to delete) alone.
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        running_ = false;
+    }
+    flow_cv_.notify_all();
+    if (flow_thread_.joinable()) flow_thread_.join();
+
+    // Stop the link threads before closing the socket they send on.
+    receiver_->stop();
+    for (milestone1::Sender* sender : senders_) {
+        if (sender) sender->stop();
+    }
+
+    socket_->close();
+
+    if (receive_thread_.joinable()) receive_thread_.join();
+
+    logger_->flush();
+}
+
+void LatticeAgreementApp::receiveLoop() {
+    ThreadScope scope(options_.thread_placement, ThreadRole::RECEIVE);
+    std::vector<uint8_t> data;
+    sockaddr_in sender_addr;
+    while (running_) {
+        try {
+            socket_->receive(data, sender_addr);
+            uint32_t peer_index = peers_.lookup(sender_addr);
+            if (peer_index == PeerDirectory::INVALID_INDEX || peer_index == my_index_) continue;
+            metrics::addPeer(metrics::PeerCounter::PACKETS_RECEIVED, peer_index);
+
+            Packet packet = Packet::deserialize(data);
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            if (!running_) break;
+            if (packet.type == MessageType::PERFECT_LINK_PAYLOAD) {
+                receiver_->handle(packet, peer_index);
+                for (size_t i = 0; i < packet.payloads.size(); i++) {
+                    if (!firstDelivery(peer_index, packet.seq_numbers[i])) continue;
+                    auto messages = LatticeMessage::deserializeBatch(*packet.payloads[i]);
+                    for (const LatticeMessage& message : messages) {
+                        handleMessage(peer_index, message);
+                    }
+                }
+                drainLoopback();
+                flushOutbox();
+            } else if (packet.type == MessageType::PERFECT_LINK_ACK && senders_[peer_index]) {
+                senders_[peer_index]->handleAck(packet);
+            }
+        } catch (const std::exception&) {
+            if (!running_) break;
+        }
+    }
+}
+
+void LatticeAgreementApp::flowLoop() {
+    ThreadScope scope(options_.thread_placement, ThreadRole::FLOW);
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    while (running_) {
+        flow_cv_.wait_for(lock, FLOW_CHECK_INTERVAL, [this] { return !running_; });
+        if (!running_) break;
+        // a silent peer may just have passed SUSPECT_TIMEOUT and stopped holding us back
+        startShots();
+        drainLoopback();
+        flushOutbox();
+    }
+}
+
+// caller holds state_mutex_
+bool LatticeAgreementApp::firstDelivery(uint32_t peer_index, uint32_t link_seq) {
+    uint32_t& watermark = link_watermark_[peer_index];
+    std::set<uint32_t>& above = link_above_[peer_index];
+    if (link_seq <= watermark || !above.insert(link_seq).second) return false;
+    while (!above.empty() && *above.begin() == watermark + 1) {
+        above.erase(above.begin());
+        watermark++;
+    }
+    return true;
+}
+
+void LatticeAgreementApp::startShots() {
+    if (next_shot_ >= shots_ || proposing_.size() >= options_.lattice_pipeline) return;
+    uint32_t limit = leadLimit(std::chrono::steady_clock::now());
+    while (next_shot_ < shots_ && next_shot_ < limit && proposing_.size() < options_.lattice_pipeline) {
+        startShot(next_shot_++);
+    }
+}
+
+uint32_t LatticeAgreementApp::leadLimit(std::chrono::steady_clock::time_point now) const {
+    uint32_t slowest = next_logged_;
+    for (uint32_t i = 0; i < n_processes_; i++) {
+        if (i == my_index_ || now - progressed_[i] > SUSPECT_TIMEOUT) continue;
+        slowest = std::min(slowest, decided_through_[i]);
+    }
+    return slowest > UINT32_MAX - MAX_LEAD ? UINT32_MAX : slowest + MAX_LEAD;
+}
+
+void LatticeAgreementApp::startShot(uint32_t shot) {
+    ProposerShot& state = proposing_[shot];
+    // A file with fewer than p lines proposes the empty set for the missing shots.
+    if (!proposal_iter_.next(proposal_buffer_)) proposal_buffer_.clear();
+    state.proposed = universe_.fromValues(proposal_buffer_);
+    state.sent = universe_.emptySet();
+    state.proposal_number = 0;
+    state.started = std::chrono::steady_clock::now();
+    propose(shot, state);
+}
+
+void LatticeAgreementApp::propose(uint32_t shot, ProposerShot& state) {
+    state.active = true;
+    state.proposal_number++;
+    state.ack_count = 0;
+    state.nack_count = 0;
+    state.responded.assign(n_processes_, false);
+
+    LatticeMessage message;
+    message.kind = MessageType::PROPOSAL;
+    message.shot = shot;
+    message.proposal_number = state.proposal_number;
+    message.values = universe_.toValues(state.proposed.minus(state.sent));
+    state.sent = state.proposed;
+    for (uint32_t i = 0; i < n_processes_; i++) {
+        sendTo(i, message);
+    }
+}
+
+// Our own copy goes through loopback_ instead of recursing, so a handler never runs
+// underneath another one that is still iterating over shot state. Everything else waits
+// in outbox_ so one pass over a packet (or the pipeline start) answers with one payload per peer.
+void LatticeAgreementApp::sendTo(uint32_t peer_index, const LatticeMessage& message) {
+    if (peer_index == my_index_) {
+        loopback_.push_back(message);
+    } else {
+        outbox_[peer_index].push_back(message);
+    }
+}
+
+void LatticeAgreementApp::flushOutbox() {
+    for (uint32_t i = 0; i < n_processes_; i++) {
+        if (outbox_[i].empty()) continue;
+        auto payloads = LatticeMessage::serializeBatch(outbox_[i], MAX_BATCH_BYTES);
+        for (std::vector<uint8_t>& payload : payloads) {
+            senders_[i]->sendPayload(std::move(payload));
+        }
+        outbox_[i].clear();
+    }
+}
+
+void LatticeAgreementApp::drainLoopback() {
+    while (!loopback_.empty()) {
+        LatticeMessage message = std::move(loopback_.front());
+        loopback_.pop_front();
+        handleMessage(my_index_, message);
+    }
+}
+
+void LatticeAgreementApp::handleMessage(uint32_t peer_index, const LatticeMessage& message) {
+    if (message.kind == MessageType::LATTICE_DECIDED) {
+        if (message.shot > decided_through_[peer_index]) {
+            decided_through_[peer_index] = message.shot;
+            progressed_[peer_index] = std::chrono::steady_clock::now();
+        }
+        collectGarbage();
+        startShots();
+        return;
+    }
+    // Below gc_floor_ everyone has decided: late copies must not resurrect acceptor state.
+    if (message.shot >= shots_ || message.shot < gc_floor_) return;
+    if (message.kind == MessageType::PROPOSAL) {
+        handleProposal(peer_index, message);
+    } else if (message.kind == MessageType::NACK || message.kind == MessageType::LATTICE_ACK) {
+        handleResponse(peer_index, message);
+    }
+}
+
+// Acceptor: rebuild the proposer's full proposal from its deltas, then ACK if it contains
+// everything accepted so far, otherwise merge it in and NACK with what it was missing.
+// Only the newest applied proposal_number is answered; the proposer ignores older ones anyway.
+void LatticeAgreementApp::handleProposal(uint32_t peer_index, const LatticeMessage& message) {
+    auto it = acceptors_.find(message.shot);
+    if (it == acceptors_.end()) {
+        AcceptorShot fresh;
+        fresh.accepted = universe_.emptySet();
+        fresh.views.assign(n_processes_, ProposerView{0, universe_.emptySet(), {}});
+        it = acceptors_.emplace(message.shot, std::move(fresh)).first;
+    }
+    AcceptorShot& acceptor = it->second;
+    ProposerView& view = acceptor.views[peer_index];
+
+    if (message.proposal_number <= view.proposal_number) return;
+    if (message.proposal_number > view.proposal_number + 1) {
+        view.early[message.proposal_number] = message.values;
+        return;
+    }
+    universe_.insertValues(view.values, message.values);
+    view.proposal_number = message.proposal_number;
+    while (!view.early.empty() && view.early.begin()->first == view.proposal_number + 1) {
+        universe_.insertValues(view.values, view.early.begin()->second);
+        view.proposal_number++;
+        view.early.erase(view.early.begin());
+    }
+
+    LatticeMessage reply;
+    reply.shot = message.shot;
+    reply.proposal_number = view.proposal_number;
+    if (view.values.includes(acceptor.accepted)) {
+        acceptor.accepted = view.values;
+        reply.kind = MessageType::LATTICE_ACK;
+    } else {
+        acceptor.accepted.unionWith(view.values);
+        reply.kind = MessageType::NACK;
+        reply.values = universe_.toValues(acceptor.accepted.minus(view.values));
+    }
+    sendTo(peer_index, reply);
+}
+
+// Proposer: responses to stale proposal numbers and duplicates from the same peer are ignored.
+void LatticeAgreementApp::handleResponse(uint32_t peer_index, const LatticeMessage& message) {
+    auto it = proposing_.find(message.shot);
+    if (it == proposing_.end()) return;
+    ProposerShot& state = it->second;
+    if (!state.active || message.proposal_number != state.proposal_number) return;
+    if (state.responded[peer_index]) return;
+    state.responded[peer_index] = true;
+
+    if (message.kind == MessageType::LATTICE_ACK) {
+        state.ack_count++;
+    } else {
+        universe_.insertValues(state.proposed, message.values);
+        state.nack_count++;
+    }
+
+    if (state.ack_count >= majority_) {
+        decide(message.shot, state);
+    } else if (state.nack_count > 0 && state.ack_count + state.nack_count >= majority_) {
+        propose(message.shot, state);
+    }
+}
+
+void LatticeAgreementApp::decide(uint32_t shot, ProposerShot& state) {
+    metrics::record(metrics::Histogram::DECISION_LATENCY_US,
+                    metrics::microsSince(state.started, std::chrono::steady_clock::now()));
+    decided_.emplace(shot, std::move(state.proposed));
+    proposing_.erase(shot);
+
+    while (!decided_.empty() && decided_.begin()->first == next_logged_) {
+        logger_->logDecision(universe_.toValues(decided_.begin()->second));
+        decided_.erase(decided_.begin());
+        next_logged_++;
+    }
+    if (next_logged_ >= announced_ + GC_ANNOUNCE_STEP || next_logged_ == shots_) {
+        announceDecided();
+    }
+    if (next_logged_ == shots_) {
+        logger_->flush();
+    }
+
+    startShots();
+}
+
+void LatticeAgreementApp::announceDecided() {
+    if (announced_ == next_logged_) return;
+    announced_ = next_logged_;
+    decided_through_[my_index_] = next_logged_;
+
+    LatticeMessage message;
+    message.kind = MessageType::LATTICE_DECIDED;
+    message.shot = next_logged_;
+    for (uint32_t i = 0; i < n_processes_; i++) {
+        if (i != my_index_) sendTo(i, message);
+    }
+    collectGarbage();
+}
+
+void LatticeAgreementApp::collectGarbage() {
+    uint32_t floor = *std::min_element(decided_through_.begin(), decided_through_.end());
+    if (floor <= gc_floor_) return;
+    acceptors_.erase(acceptors_.begin(), acceptors_.lower_bound(floor));
+    gc_floor_ = floor;
+}
+
+}
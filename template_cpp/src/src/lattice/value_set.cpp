@@ -0,0 +1,232 @@
+#include "lattice/value_set.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace milestone3 {
+
+// Bitset kernels. GCC/Clang vector extensions give 4 x 64-bit lanes that the compiler
+// lowers to whatever the target has (SSE2, NEON, or scalar) without -mavx2 / arch intrinsics.
+#if defined(__GNUC__)
+typedef uint64_t Lanes __attribute__((vector_size(32)));
+static constexpr size_t LANE_WORDS = sizeof(Lanes) / sizeof(uint64_t);
+#endif
+
+// dst |= src over n words; returns true if dst gained a bit
+static bool or_words(uint64_t* dst, const uint64_t* src, size_t n) {
+    size_t i = 0;
+    uint64_t grew = 0;
+#if defined(__GNUC__)
+    Lanes grew_lanes = {0, 0, 0, 0};
+    for (; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        Lanes d, s;
+        std::memcpy(&d, dst + i, sizeof(d));
+        std::memcpy(&s, src + i, sizeof(s));
+        grew_lanes |= s & ~d;
+        d |= s;
+        std::memcpy(dst + i, &d, sizeof(d));
+    }
+    grew = grew_lanes[0] | grew_lanes[1] | grew_lanes[2] | grew_lanes[3];
+#endif
+    for (; i < n; i++) {
+        grew |= src[i] & ~dst[i];
+        dst[i] |= src[i];
+    }
+    return grew != 0;
+}
+
+// true if every bit of sub is set in super (over n words)
+static bool subset_words(const uint64_t* sub, const uint64_t* super, size_t n) {
+    size_t i = 0;
+#if defined(__GNUC__)
+    for (; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        Lanes a, b;
+        std::memcpy(&a, sub + i, sizeof(a));
+        std::memcpy(&b, super + i, sizeof(b));
+        Lanes extra = a & ~b;
+        if ((extra[0] | extra[1] | extra[2] | extra[3]) != 0) return false;
+    }
+#endif
+    for (; i < n; i++) {
+        if ((sub[i] & ~super[i]) != 0) return false;
+    }
+    return true;
+}
+
+// dst = a & ~b over n words
+static void andnot_words(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n) {
+    size_t i = 0;
+#if defined(__GNUC__)
+    for (; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        Lanes x, y;
+        std::memcpy(&x, a + i, sizeof(x));
+        std::memcpy(&y, b + i, sizeof(y));
+        x &= ~y;
+        std::memcpy(dst + i, &x, sizeof(x));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = a[i] & ~b[i];
+    }
+}
+
+static bool any_words(const uint64_t* words, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (words[i] != 0) return true;
+    }
+    return false;
+}
+
+// ======================
+// ValueSet
+// ======================
+
+ValueSet::ValueSet(Kind kind, size_t words) : kind_(kind) {
+    if (kind_ == Kind::DENSE) words_.assign(words, 0);
+}
+
+bool ValueSet::empty() const {
+    if (kind_ == Kind::SPARSE) return sorted_.empty();
+    return !any_words(words_.data(), words_.size());
+}
+
+size_t ValueSet::size() const {
+    if (kind_ == Kind::SPARSE) return sorted_.size();
+    size_t count = 0;
+    for (uint64_t word : words_) {
+        count += static_cast<size_t>(__builtin_popcountll(word));
+    }
+    return count;
+}
+
+bool ValueSet::insert(uint32_t key) {
+    if (kind_ == Kind::SPARSE) {
+        auto it = std::lower_bound(sorted_.begin(), sorted_.end(), key);
+        if (it != sorted_.end() && *it == key) return false;
+        sorted_.insert(it, key);
+        return true;
+    }
+    size_t word = key / 64;
+    uint64_t bit = 1ull << (key % 64);
+    if (word >= words_.size()) words_.resize(word + 1, 0);
+    if (words_[word] & bit) return false;
+    words_[word] |= bit;
+    return true;
+}
+
+bool ValueSet::contains(uint32_t key) const {
+    if (kind_ == Kind::SPARSE) {
+        return std::binary_search(sorted_.begin(), sorted_.end(), key);
+    }
+    size_t word = key / 64;
+    return word < words_.size() && (words_[word] >> (key % 64)) & 1;
+}
+
+bool ValueSet::unionWith(const ValueSet& other) {
+    if (kind_ == Kind::DENSE) {
+        if (other.words_.size() > words_.size()) words_.resize(other.words_.size(), 0);
+        return or_words(words_.data(), other.words_.data(), other.words_.size());
+    }
+
+    // Merge kernel; the common "nothing new" case returns without allocating.
+    if (includes(other)) return false;
+    std::vector<uint32_t> merged;
+    merged.reserve(sorted_.size() + other.sorted_.size());
+    auto a = sorted_.begin(), a_end = sorted_.end();
+    auto b = other.sorted_.begin(), b_end = other.sorted_.end();
+    while (a != a_end && b != b_end) {
+        if (*a < *b) {
+            merged.push_back(*a++);
+        } else if (*b < *a) {
+            merged.push_back(*b++);
+        } else {
+            merged.push_back(*a++);
+            ++b;
+        }
+    }
+    merged.insert(merged.end(), a, a_end);
+    merged.insert(merged.end(), b, b_end);
+    sorted_.swap(merged);
+    return true;
+}
+
+bool ValueSet::includes(const ValueSet& other) const {
+    if (kind_ == Kind::DENSE) {
+        size_t common = std::min(words_.size(), other.words_.size());
+        if (!subset_words(other.words_.data(), words_.data(), common)) return false;
+        return !any_words(other.words_.data() + common, other.words_.size() - common);
+    }
+    if (other.sorted_.size() > sorted_.size()) return false;
+    return std::includes(sorted_.begin(), sorted_.end(), other.sorted_.begin(), other.sorted_.end());
+}
+
+ValueSet ValueSet::minus(const ValueSet& other) const {
+    ValueSet result(kind_);
+    if (kind_ == Kind::DENSE) {
+        result.words_ = words_;
+        size_t common = std::min(words_.size(), other.words_.size());
+        andnot_words(result.words_.data(), words_.data(), other.words_.data(), common);
+        return result;
+    }
+    std::set_difference(sorted_.begin(), sorted_.end(), other.sorted_.begin(), other.sorted_.end(),
+                        std::back_inserter(result.sorted_));
+    return result;
+}
+
+// ======================
+// ValueUniverse
+// ======================
+
+ValueUniverse::ValueUniverse(uint32_t distinct_values, uint32_t max_values)
+    : kind_(ValueSet::Kind::SPARSE), words_(0) {
+    uint64_t bitset_bytes = (static_cast<uint64_t>(distinct_values) + 7) / 8;
+    uint64_t sorted_bytes = static_cast<uint64_t>(max_values) * sizeof(uint32_t);
+    if (distinct_values <= MAX_DENSE_UNIVERSE &&
+        (distinct_values <= SMALL_UNIVERSE || bitset_bytes <= sorted_bytes)) {
+        kind_ = ValueSet::Kind::DENSE;
+        words_ = (static_cast<size_t>(distinct_values) + 63) / 64;
+        ids_.reserve(distinct_values);
+        values_.reserve(distinct_values);
+    }
+}
+
+uint32_t ValueUniverse::keyOf(uint32_t value) {
+    if (kind_ == ValueSet::Kind::SPARSE) return value;
+    auto inserted = ids_.emplace(value, static_cast<uint32_t>(values_.size()));
+    if (inserted.second) values_.push_back(value);
+    return inserted.first->second;
+}
+
+ValueSet ValueUniverse::fromValues(const std::vector<uint32_t>& values) {
+    ValueSet set = emptySet();
+    insertValues(set, values);
+    return set;
+}
+
+void ValueUniverse::insertValues(ValueSet& set, const std::vector<uint32_t>& values) {
+    if (kind_ == ValueSet::Kind::SPARSE && values.size() > 1) {
+        ValueSet incoming(ValueSet::Kind::SPARSE);
+        std::vector<uint32_t> sorted(values);
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        for (uint32_t value : sorted) incoming.insert(value);  // appends: already in order
+        set.unionWith(incoming);
+        return;
+    }
+    for (uint32_t value : values) {
+        set.insert(keyOf(value));
+    }
+}
+
+std::vector<uint32_t> ValueUniverse::toValues(const ValueSet& set) const {
+    std::vector<uint32_t> values;
+    values.reserve(set.size());
+    if (kind_ == ValueSet::Kind::SPARSE) {
+        set.forEachKey([&values](uint32_t key) { values.push_back(key); });
+    } else {
+        set.forEachKey([this, &values](uint32_t key) { values.push_back(values_[key]); });
+    }
+    return values;
+}
+
+}
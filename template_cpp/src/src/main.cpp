@@ -5,8 +5,22 @@
 #include "parser.hpp"
 #include "common/signal_handler.hpp"
 #include "common/config.hpp"
+#include "common/runtime_options.hpp"
+#include "common/metrics.hpp"
 #include "perfectlink/perfect_link_app.hpp"
 #include "fifobroadcast/fifo_broadcast_app.hpp"
+#include "lattice/lattice_agreement_app.hpp"
+
+//从收到停止信号（或sender的最后一个ACK）到shutdown完成的时间，记到metrics里，最后一次dump会带上
+template <typename App>
+static void shutdownAndRecord(App& app)
+{
+    auto stop_requested = SignalHandler::stopRequestedAt();
+    app.shutdown();
+    auto elapsed = std::chrono::steady_clock::now() - stop_requested;
+    metrics::add(metrics::Counter::SHUTDOWN_US,
+                 static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+}
 
 int main(int argc, char** argv) 
 {
@@ -15,6 +29,12 @@ int main(int argc, char** argv)
     
     SignalHandler::setup();
     Config config = Config::parse(parser.configPath());
+    RuntimeOptions options = RuntimeOptions::fromEnv();
+    //metrics快照写在输出文件旁边，收到停止信号shutdown之后再写最后一次
+    if (options.metrics_enabled)
+    {
+        metrics::startReporter(parser.outputPath() + std::string(".metrics"), options.metrics_interval_ms);
+    }
     
     if (config.getType() == ConfigType::PERFECT_LINK) 
     {
@@ -38,27 +58,28 @@ int main(int argc, char** argv)
           hosts,
           pl_config.m,
           pl_config.receiver_id,
-          parser.outputPath()
+          parser.outputPath(),
+          options
       );
       
-      app.run();
-      
-      //如果是sender在run结束后已经确认所有acked，可以直接shutdown退出
+      //如果是sender，run会一直等到所有消息被acked；放到单独线程里，这样等待期间收到停止信号也能马上shutdown
+      //作为receiver，是不知道还有多少消息需要收的，只能等收到停止信号后再shutdown
       if (app.isSender())
       {
-          app.shutdown();
+          std::thread runner([&app] {
+              app.run();
+              SignalHandler::wake();
+          });
+          SignalHandler::waitForStop();
+          app.interrupt();
+          runner.join();
       } 
       else 
-      //作为receiver，是不知道还有多少消息需要收的，只能等收到停止信号后再shutdown
       {
-          int wait_count = 0;
-          //SignalHandler::setup()会设置stop_flag_，捕捉SIGINT信号，这里每100ms检查一次是否收到停止信号
-          while (!SignalHandler::shouldStop()) 
-          {
-              std::this_thread::sleep_for(std::chrono::milliseconds(100));
-          }
-          app.shutdown();
-      };
+          app.run();
+          SignalHandler::waitForStop();
+      }
+      shutdownAndRecord(app);
     }
     else if (config.getType() == ConfigType::FIFO_BROADCAST)
     {
@@ -79,16 +100,40 @@ int main(int argc, char** argv)
           static_cast<uint32_t>(parser.id()),
           hosts,
           fifo_config.m,
-          parser.outputPath()
+          parser.outputPath(),
+          options
       );
       
       app.run();
       
-      while (!SignalHandler::shouldStop()) 
+      SignalHandler::waitForStop();
+      shutdownAndRecord(app);
+    }
+    else if (config.getType() == ConfigType::LATTICE_AGREEMENT)
+    {
+      auto parser_hosts = parser.hosts();
+      std::vector<Host> hosts;
+      for (const auto& ph : parser_hosts) 
       {
-          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+          hosts.emplace_back(
+              static_cast<uint32_t>(ph.id),
+              ph.ipReadable(),
+              ph.portReadable()
+          );
       }
-      app.shutdown();
+
+      milestone3::LatticeAgreementApp app(
+          static_cast<uint32_t>(parser.id()),
+          hosts,
+          config.getLatticeAgreementConfig(),
+          parser.outputPath(),
+          options
+      );
+      
+      app.run();
+      
+      SignalHandler::waitForStop();
+      shutdownAndRecord(app);
     }
     else 
     {
@@ -96,5 +141,6 @@ int main(int argc, char** argv)
       return 1;
     }
     
+    metrics::stopReporter();
     return 0;
 }
\ No newline at end of file
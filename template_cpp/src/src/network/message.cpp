@@ -1,5 +1,8 @@
 #include "network/message.hpp"
+#include <algorithm>
+#include <cassert>
 #include <cstring>
+#include <stdexcept>
 
 static void write_uint32(std::vector<uint8_t>& buffer, uint32_t value) {
     buffer.push_back(static_cast<uint8_t>((value >> 24) & 0xFF));
@@ -7,6 +10,10 @@ static void write_uint32(std::vector<uint8_t>& buffer, uint32_t value) {
     buffer.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
     buffer.push_back(static_cast<uint8_t>(value & 0xFF));
 }
+static void write_uint64(std::vector<uint8_t>& buffer, uint64_t value) {
+    write_uint32(buffer, static_cast<uint32_t>(value >> 32));
+    write_uint32(buffer, static_cast<uint32_t>(value & 0xFFFFFFFFu));
+}
 static uint32_t read_uint32(const std::vector<uint8_t>& buffer, size_t& pos) {
     uint32_t value = 0;
     value |= static_cast<uint32_t>(buffer[pos++]) << 24;
@@ -19,38 +26,174 @@ static uint32_t read_uint32(const std::vector<uint8_t>& buffer, size_t& pos) {
 std::vector<uint8_t> Packet::serialize() const 
 {
     std::vector<uint8_t> buffer;
+    serializeInto(buffer);
+    return buffer;
+}
+
+void Packet::serializeInto(std::vector<uint8_t>& buffer) const 
+{
+    serializeHeader(buffer);
+    for (const SharedPayload& payload : payloads) 
+    {
+        buffer.insert(buffer.end(), payload->begin(), payload->end());
+    }
+}
+
+void Packet::serializeHeader(std::vector<uint8_t>& buffer) const 
+{
+    assert(seq_numbers.size() <= MAX_ENTRIES && acks.size() <= MAX_ENTRIES);
+    assert(stamps.size() <= MAX_ENTRIES && digest.size() <= MAX_ENTRIES);
+    buffer.clear();
     buffer.push_back(static_cast<uint8_t>(type));
-    if (type == MessageType::PERFECT_LINK_DATA) 
+    if (type == MessageType::PERFECT_LINK_DATA || type == MessageType::BROADCAST_DATA || hasPayloads()) 
     {
         write_uint32(buffer, sender_id);
     }
-    buffer.push_back(static_cast<uint8_t>(seq_numbers.size()));
-    for (uint32_t seq : seq_numbers) {
-        write_uint32(buffer, seq);
+    if (hasPayloads()) 
+    {
+        //每条消息: [seq u32][len u32]，消息体在包尾按同样顺序排列
+        buffer.push_back(static_cast<uint8_t>(seq_numbers.size()));
+        for (size_t i = 0; i < seq_numbers.size(); i++) {
+            write_uint32(buffer, seq_numbers[i]);
+            write_uint32(buffer, static_cast<uint32_t>(payloads[i]->size()));
+        }
+    }
+    else if (type != MessageType::BROADCAST_ACK && type != MessageType::BROADCAST_DIGEST) 
+    {
+        buffer.push_back(static_cast<uint8_t>(seq_numbers.size()));
+        for (uint32_t seq : seq_numbers) {
+            write_uint32(buffer, seq);
+        }
+    }
+    if (type == MessageType::BROADCAST_DATA || type == MessageType::BROADCAST_ACK ||
+        type == MessageType::BROADCAST_PAYLOAD) 
+    {
+        buffer.push_back(static_cast<uint8_t>(acks.size()));
+        for (const Message& ack : acks) {
+            write_uint32(buffer, ack.sender_id);
+            write_uint32(buffer, ack.seq_number);
+        }
+    }
+    //可选尾部: [count u8][(seq u32, broadcast_us u64)...]，不带trace的包和原来一样长
+    //BROADCAST_PAYLOAD后面还有消息体，所以count总是写
+    if ((type == MessageType::BROADCAST_DATA && !stamps.empty()) || type == MessageType::BROADCAST_PAYLOAD) 
+    {
+        buffer.push_back(static_cast<uint8_t>(stamps.size()));
+        for (const TraceStamp& stamp : stamps) {
+            write_uint32(buffer, stamp.seq);
+            write_uint64(buffer, stamp.broadcast_us);
+        }
+    }
+    if (type == MessageType::BROADCAST_DIGEST) 
+    {
+        buffer.push_back(static_cast<uint8_t>(digest.size()));
+        for (const DigestEntry& entry : digest) {
+            write_uint32(buffer, entry.origin);
+            write_uint32(buffer, entry.watermark);
+            write_uint64(buffer, entry.received_above);
+        }
     }
-    return buffer;
 }
 
 // packet的原始赋值通过反序列化函数实现
 Packet Packet::deserialize(const std::vector<uint8_t>& data) 
 {
     Packet packet;
+    deserializeInto(data, packet);
+    return packet;
+}
+
+void Packet::deserializeInto(const std::vector<uint8_t>& data, Packet& packet) 
+{
+    //clear()保留capacity，复用同一个Packet时不再分配
+    packet.sender_id = 0;
+    packet.seq_numbers.clear();
+    packet.acks.clear();
+    packet.digest.clear();
+    packet.payloads.clear();
+    packet.stamps.clear();
     size_t pos = 0;
     
     packet.type = static_cast<MessageType>(data[pos++]);
-    if (packet.type == MessageType::PERFECT_LINK_DATA) 
+    if (packet.type == MessageType::PERFECT_LINK_DATA || packet.type == MessageType::BROADCAST_DATA ||
+        packet.hasPayloads()) 
     {
         packet.sender_id = read_uint32(data, pos);
     }
-    uint8_t count = data[pos++];
-
-    for (uint8_t i = 0; i < count; i++) 
+    //消息体的长度先记在lengths里，头部读完之后再切出来
+    std::vector<uint32_t> lengths;
+    if (packet.hasPayloads()) 
     {
-        uint32_t seq = read_uint32(data, pos);
-        packet.seq_numbers.push_back(seq);
+        uint8_t count = data[pos++];
+        if (data.size() - pos < static_cast<size_t>(count) * 8) 
+        {
+            throw std::runtime_error("Truncated payload header in packet");
+        }
+        lengths.reserve(count);
+        for (uint8_t i = 0; i < count; i++) 
+        {
+            packet.seq_numbers.push_back(read_uint32(data, pos));
+            lengths.push_back(read_uint32(data, pos));
+        }
+    }
+    else if (packet.type != MessageType::BROADCAST_ACK && packet.type != MessageType::BROADCAST_DIGEST) 
+    {
+        uint8_t count = data[pos++];
+        for (uint8_t i = 0; i < count; i++) 
+        {
+            uint32_t seq = read_uint32(data, pos);
+            packet.seq_numbers.push_back(seq);
+        }
+    }
+    if (packet.type == MessageType::BROADCAST_DATA || packet.type == MessageType::BROADCAST_ACK ||
+        packet.type == MessageType::BROADCAST_PAYLOAD) 
+    {
+        uint8_t ack_count = data[pos++];
+        for (uint8_t i = 0; i < ack_count; i++) 
+        {
+            uint32_t origin = read_uint32(data, pos);
+            uint32_t seq = read_uint32(data, pos);
+            packet.acks.emplace_back(origin, seq);
+        }
+    }
+    if ((packet.type == MessageType::BROADCAST_DATA && pos < data.size()) ||
+        packet.type == MessageType::BROADCAST_PAYLOAD) 
+    {
+        uint8_t stamp_count = data[pos++];
+        if (data.size() - pos < static_cast<size_t>(stamp_count) * 12) 
+        {
+            throw std::runtime_error("Truncated trace stamps in packet");
+        }
+        for (uint8_t i = 0; i < stamp_count; i++) 
+        {
+            uint32_t seq = read_uint32(data, pos);
+            uint64_t high = read_uint32(data, pos);
+            packet.stamps.emplace_back(seq, (high << 32) | read_uint32(data, pos));
+        }
+    }
+    if (packet.type == MessageType::BROADCAST_DIGEST) 
+    {
+        uint8_t entry_count = data[pos++];
+        for (uint8_t i = 0; i < entry_count; i++) 
+        {
+            DigestEntry entry;
+            entry.origin = read_uint32(data, pos);
+            entry.watermark = read_uint32(data, pos);
+            uint64_t high = read_uint32(data, pos);
+            entry.received_above = (high << 32) | read_uint32(data, pos);
+            packet.digest.push_back(entry);
+        }
+    }
+    for (uint32_t length : lengths) 
+    {
+        if (length > data.size() - pos) 
+        {
+            throw std::runtime_error("Truncated payload in packet");
+        }
+        auto begin = data.begin() + static_cast<std::ptrdiff_t>(pos);
+        packet.payloads.push_back(std::make_shared<const std::vector<uint8_t>>(begin, begin + length));
+        pos += length;
     }
-    
-    return packet;
 }
 
 Packet Packet::createDataPacket(uint32_t sender_id, const std::vector<uint32_t>& seq_numbers) 
@@ -62,6 +205,17 @@ Packet Packet::createDataPacket(uint32_t sender_id, const std::vector<uint32_t>&
     return packet;
 }
 
+Packet Packet::createPayloadPacket(uint32_t sender_id, const std::vector<uint32_t>& seq_numbers,
+                                   const std::vector<SharedPayload>& payloads) 
+{
+    Packet packet;
+    packet.type = MessageType::PERFECT_LINK_PAYLOAD;
+    packet.sender_id = sender_id;
+    packet.seq_numbers = seq_numbers;
+    packet.payloads = payloads;
+    return packet;
+}
+
 Packet Packet::createAckPacket(const std::vector<uint32_t>& seq_numbers) 
 {
     Packet packet;
@@ -69,4 +223,183 @@ Packet Packet::createAckPacket(const std::vector<uint32_t>& seq_numbers)
     packet.sender_id = 0;  // Not used for ACK
     packet.seq_numbers = seq_numbers;
     return packet;
-}
\ No newline at end of file
+}
+
+Packet Packet::createBroadcastAckPacket(const std::vector<Message>& acks) 
+{
+    Packet packet;
+    packet.type = MessageType::BROADCAST_ACK;
+    packet.sender_id = 0;  // Not used for ACK
+    packet.acks = acks;
+    return packet;
+}
+
+Packet Packet::createDigestPacket(const std::vector<DigestEntry>& digest) 
+{
+    Packet packet;
+    packet.type = MessageType::BROADCAST_DIGEST;
+    packet.sender_id = 0;
+    packet.digest = digest;
+    return packet;
+}
+
+// LatticeMessage batch: messages back to back until the end of the payload, each
+//   [kind u8][shot varint, delta from the previous message][proposal_number varint][values]
+// and, for PROPOSAL and NACK, values as whichever is shorter of
+//   [0][count varint][first varint][gap - 1 varint ...]      (sorted)
+//   [1][min varint][byte count varint][bitmap, bit i = min + i]
+static constexpr uint8_t VALUES_LIST = 0;
+static constexpr uint8_t VALUES_BITMAP = 1;
+
+static void write_varint(std::vector<uint8_t>& buffer, uint32_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<uint8_t>(value));
+}
+static uint32_t read_varint(const std::vector<uint8_t>& buffer, size_t& pos) {
+    uint32_t value = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        if (pos >= buffer.size()) break;
+        uint8_t byte = buffer[pos++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+    throw std::runtime_error("Truncated varint in lattice message");
+}
+static size_t varint_size(uint32_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static void write_values(std::vector<uint8_t>& buffer, std::vector<uint32_t>& values) {
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+
+    size_t list_bytes = varint_size(static_cast<uint32_t>(values.size()));
+    for (size_t i = 0; i < values.size(); i++) {
+        list_bytes += varint_size(i == 0 ? values[0] : values[i] - values[i - 1] - 1);
+    }
+    if (!values.empty()) {
+        uint64_t bitmap_bytes = (static_cast<uint64_t>(values.back()) - values.front()) / 8 + 1;
+        if (bitmap_bytes + varint_size(values.front()) + 5 < list_bytes) {
+            buffer.push_back(VALUES_BITMAP);
+            write_varint(buffer, values.front());
+            write_varint(buffer, static_cast<uint32_t>(bitmap_bytes));
+            size_t start = buffer.size();
+            buffer.resize(start + bitmap_bytes, 0);
+            for (uint32_t value : values) {
+                uint32_t bit = value - values.front();
+                buffer[start + bit / 8] = static_cast<uint8_t>(buffer[start + bit / 8] | (1u << (bit % 8)));
+            }
+            return;
+        }
+    }
+    buffer.push_back(VALUES_LIST);
+    write_varint(buffer, static_cast<uint32_t>(values.size()));
+    for (size_t i = 0; i < values.size(); i++) {
+        write_varint(buffer, i == 0 ? values[0] : values[i] - values[i - 1] - 1);
+    }
+}
+
+static void read_values(const std::vector<uint8_t>& buffer, size_t& pos, std::vector<uint32_t>& values) {
+    if (pos >= buffer.size()) throw std::runtime_error("Truncated lattice message");
+    uint8_t encoding = buffer[pos++];
+    if (encoding == VALUES_BITMAP) {
+        uint32_t base = read_varint(buffer, pos);
+        uint32_t bytes = read_varint(buffer, pos);
+        if (bytes > buffer.size() - pos) throw std::runtime_error("Truncated lattice message");
+        for (uint32_t i = 0; i < bytes; i++) {
+            for (uint8_t bits = buffer[pos + i]; bits != 0; bits = static_cast<uint8_t>(bits & (bits - 1))) {
+                values.push_back(base + i * 8 + static_cast<uint32_t>(__builtin_ctz(bits)));
+            }
+        }
+        pos += bytes;
+        return;
+    }
+    uint32_t count = read_varint(buffer, pos);
+    if (count > buffer.size() - pos) throw std::runtime_error("Truncated lattice message");
+    values.reserve(count);
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t delta = read_varint(buffer, pos);
+        value = (i == 0) ? delta : value + delta + 1;
+        values.push_back(value);
+    }
+}
+
+std::vector<std::vector<uint8_t>> LatticeMessage::serializeBatch(std::vector<LatticeMessage>& messages,
+                                                                 size_t max_bytes) 
+{
+    std::stable_sort(messages.begin(), messages.end(),
+                     [](const LatticeMessage& a, const LatticeMessage& b) { return a.shot < b.shot; });
+    std::vector<std::vector<uint8_t>> payloads;
+    uint32_t previous_shot = 0;
+    for (LatticeMessage& message : messages) 
+    {
+        if (payloads.empty() || payloads.back().size() >= max_bytes) 
+        {
+            payloads.emplace_back();
+            previous_shot = 0;
+        }
+        std::vector<uint8_t>& buffer = payloads.back();
+        buffer.push_back(static_cast<uint8_t>(message.kind));
+        write_varint(buffer, message.shot - previous_shot);
+        write_varint(buffer, message.proposal_number);
+        if (message.hasValues()) 
+        {
+            write_values(buffer, message.values);
+        }
+        previous_shot = message.shot;
+    }
+    return payloads;
+}
+
+std::vector<LatticeMessage> LatticeMessage::deserializeBatch(const std::vector<uint8_t>& data) 
+{
+    std::vector<LatticeMessage> messages;
+    size_t pos = 0;
+    uint32_t previous_shot = 0;
+    while (pos < data.size()) 
+    {
+        LatticeMessage message;
+        message.kind = static_cast<MessageType>(data[pos++]);
+        message.shot = previous_shot + read_varint(data, pos);
+        message.proposal_number = read_varint(data, pos);
+        if (message.hasValues()) 
+        {
+            read_values(data, pos, message.values);
+        }
+        previous_shot = message.shot;
+        messages.push_back(std::move(message));
+    }
+    return messages;
+}
+
+OutgoingPacket::OutgoingPacket() 
+{
+    bytes.reserve(RESERVED_BYTES);
+    packet.seq_numbers.reserve(RESERVED_ENTRIES);
+    packet.acks.reserve(RESERVED_ENTRIES);
+    packet.stamps.reserve(RESERVED_ENTRIES);
+    packet.payloads.reserve(RESERVED_ENTRIES);
+    parts.reserve(RESERVED_ENTRIES + 1);
+}
+
+const std::vector<iovec>& OutgoingPacket::gather() 
+{
+    packet.serializeHeader(bytes);
+    parts.clear();
+    parts.push_back({bytes.data(), bytes.size()});
+    for (const SharedPayload& payload : packet.payloads) 
+    {
+        //iovec不带const，但sendmsg只读不写
+        parts.push_back({const_cast<uint8_t*>(payload->data()), payload->size()});
+    }
+    return parts;
+}
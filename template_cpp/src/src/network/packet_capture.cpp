@@ -0,0 +1,132 @@
+#include "network/packet_capture.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+static const char MAGIC[8] = {'D', 'A', 'C', 'A', 'P', '0', '0', '1'};
+static constexpr size_t RECORD_HEADER_BYTES = 8 + 4 + 2 + 2;
+
+static void put_uint(std::vector<uint8_t>& buffer, uint64_t value, unsigned bytes)
+{
+    for (unsigned i = bytes; i > 0; i--)
+    {
+        buffer.push_back(static_cast<uint8_t>((value >> (8 * (i - 1))) & 0xFF));
+    }
+}
+
+static uint64_t get_uint(const std::vector<uint8_t>& buffer, size_t& pos, unsigned bytes)
+{
+    uint64_t value = 0;
+    for (unsigned i = 0; i < bytes; i++)
+    {
+        value = (value << 8) | buffer[pos++];
+    }
+    return value;
+}
+
+// ======================
+// PacketCaptureWriter
+// ======================
+
+PacketCaptureWriter::PacketCaptureWriter(const std::string& path, uint32_t my_id, const PeerDirectory& peers)
+    : out_(path, std::ios::binary | std::ios::trunc), start_(std::chrono::steady_clock::now())
+{
+    if (!out_.is_open())
+    {
+        throw std::runtime_error("Failed to open capture file " + path);
+    }
+    buffer_.reserve(BUFFER_BYTES + 65536);
+    buffer_.insert(buffer_.end(), std::begin(MAGIC), std::end(MAGIC));
+    put_uint(buffer_, my_id, 4);
+    put_uint(buffer_, peers.size(), 4);
+    for (const Peer& peer : peers.peers())
+    {
+        put_uint(buffer_, peer.id, 4);
+        put_uint(buffer_, ntohl(peer.addr.sin_addr.s_addr), 4);
+        put_uint(buffer_, peer.host.port, 2);
+    }
+}
+
+PacketCaptureWriter::~PacketCaptureWriter()
+{
+    close();
+}
+
+void PacketCaptureWriter::record(const sockaddr_in& source, const std::vector<uint8_t>& data)
+{
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    put_uint(buffer_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()), 8);
+    put_uint(buffer_, ntohl(source.sin_addr.s_addr), 4);
+    put_uint(buffer_, ntohs(source.sin_port), 2);
+    put_uint(buffer_, data.size(), 2);
+    buffer_.insert(buffer_.end(), data.begin(), data.end());
+    if (buffer_.size() >= BUFFER_BYTES) writeBuffer();
+}
+
+void PacketCaptureWriter::writeBuffer()
+{
+    out_.write(reinterpret_cast<const char*>(buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+}
+
+void PacketCaptureWriter::close()
+{
+    if (!out_.is_open()) return;
+    writeBuffer();
+    out_.close();
+}
+
+// ======================
+// PacketCapture
+// ======================
+
+PacketCapture PacketCapture::load(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+    {
+        throw std::runtime_error("Failed to open capture file " + path);
+    }
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    PacketCapture capture;
+    size_t pos = sizeof(MAGIC);
+    if (file.size() < pos + 8 || std::memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0)
+    {
+        throw std::runtime_error(path + " is not a packet capture");
+    }
+    capture.my_id = static_cast<uint32_t>(get_uint(file, pos, 4));
+    uint64_t n = get_uint(file, pos, 4);
+    if (file.size() - pos < n * 10)
+    {
+        throw std::runtime_error(path + ": truncated peer list");
+    }
+    for (uint64_t i = 0; i < n; i++)
+    {
+        uint32_t id = static_cast<uint32_t>(get_uint(file, pos, 4));
+        in_addr addr;
+        addr.s_addr = htonl(static_cast<uint32_t>(get_uint(file, pos, 4)));
+        uint16_t port = static_cast<uint16_t>(get_uint(file, pos, 2));
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr, ip, INET_ADDRSTRLEN);
+        capture.hosts.emplace_back(id, ip, port);
+    }
+
+    while (file.size() - pos >= RECORD_HEADER_BYTES)
+    {
+        CapturedDatagram datagram;
+        std::memset(&datagram.source, 0, sizeof(datagram.source));
+        datagram.source.sin_family = AF_INET;
+        datagram.t_us = get_uint(file, pos, 8);
+        datagram.source.sin_addr.s_addr = htonl(static_cast<uint32_t>(get_uint(file, pos, 4)));
+        datagram.source.sin_port = htons(static_cast<uint16_t>(get_uint(file, pos, 2)));
+        size_t length = static_cast<size_t>(get_uint(file, pos, 2));
+        if (file.size() - pos < length) break;
+        auto begin = file.begin() + static_cast<std::ptrdiff_t>(pos);
+        datagram.data.assign(begin, begin + static_cast<std::ptrdiff_t>(length));
+        pos += length;
+        capture.datagrams.push_back(std::move(datagram));
+    }
+    return capture;
+}
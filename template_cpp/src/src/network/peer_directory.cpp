@@ -0,0 +1,102 @@
+#include "network/peer_directory.hpp"
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static sockaddr_in make_sockaddr(in_addr_t ip, uint16_t port)
+{
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ip;
+    addr.sin_port = htons(port);
+    return addr;
+}
+
+// splitmix64: deterministic stream of odd multipliers to try for the perfect hash
+static uint64_t next_multiplier(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (z ^ (z >> 31)) | 1ull;
+}
+
+PeerDirectory::PeerDirectory(const std::vector<Host>& hosts)
+    : multiplier_(1), shift_(63)
+{
+    uint32_t max_id = 0;
+    std::vector<std::pair<uint64_t, uint32_t>> keys;
+    peers_.reserve(hosts.size());
+
+    for (const Host& host : hosts)
+    {
+        in_addr_t ip;
+        if (inet_pton(AF_INET, host.ip.c_str(), &ip) <= 0)
+        {
+            throw std::runtime_error("Invalid IP address in hosts: " + host.ip);
+        }
+
+        Peer peer;
+        peer.id = host.id;
+        peer.index = static_cast<uint32_t>(peers_.size());
+        peer.host = host;
+        peer.addr = make_sockaddr(ip, host.port);
+        peers_.push_back(peer);
+
+        keys.push_back({makeKey(ip, peer.addr.sin_port), peer.index});
+        if (host.id > max_id) max_id = host.id;
+    }
+
+    id_to_index_.assign(static_cast<size_t>(max_id) + 1, INVALID_INDEX);
+    for (const Peer& peer : peers_)
+    {
+        if (id_to_index_[peer.id] != INVALID_INDEX)
+        {
+            throw std::runtime_error("Duplicate process id in hosts: " + std::to_string(peer.id));
+        }
+        id_to_index_[peer.id] = peer.index;
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 1; i < sorted.size(); i++)
+    {
+        if (sorted[i].first == sorted[i - 1].first)
+        {
+            throw std::runtime_error("Duplicate address in hosts file");
+        }
+    }
+
+    // Start at a load factor <= 1/2 and grow the table until some multiplier is collision-free.
+    unsigned bits = 2;
+    while ((static_cast<size_t>(1) << bits) < keys.size() * 2) bits++;
+
+    uint64_t state = 0;
+    for (;; bits++)
+    {
+        for (int attempt = 0; attempt < 64; attempt++)
+        {
+            if (buildTable(keys, bits, next_multiplier(state))) return;
+        }
+    }
+}
+
+bool PeerDirectory::buildTable(const std::vector<std::pair<uint64_t, uint32_t>>& keys,
+                               unsigned bits, uint64_t multiplier)
+{
+    multiplier_ = multiplier;
+    shift_ = 64 - bits;
+    slot_keys_.assign(static_cast<size_t>(1) << bits, 0);
+    slot_index_.assign(static_cast<size_t>(1) << bits, INVALID_INDEX);
+
+    for (const auto& [key, index] : keys)
+    {
+        size_t slot = slotOf(key);
+        if (slot_keys_[slot] != 0) return false;
+        slot_keys_[slot] = key;
+        slot_index_[slot] = index;
+    }
+    return true;
+}
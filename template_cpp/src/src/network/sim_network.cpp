@@ -0,0 +1,187 @@
+#include "network/sim_network.hpp"
+#include "common/metrics.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+#include <stdexcept>
+
+using std::chrono::microseconds;
+
+static uint64_t address_key(const sockaddr_in& addr)
+{
+    return (static_cast<uint64_t>(ntohl(addr.sin_addr.s_addr)) << 16) | ntohs(addr.sin_port);
+}
+
+// ======================
+// NetworkProfile
+// ======================
+
+const std::vector<NetworkProfile>& NetworkProfile::presets()
+{
+    static const std::vector<NetworkProfile> profiles = {
+        {"ideal", 0.0, 0.0, 0.0, microseconds(0), microseconds(0), microseconds(0)},
+        {"lan", 0.001, 0.0, 0.0, microseconds(100), microseconds(50), microseconds(0)},
+        {"lossy", 0.1, 0.05, 0.25, microseconds(1000), microseconds(500), microseconds(2000)},
+        {"tc", 0.1, 0.0, 0.25, microseconds(200000), microseconds(50000), microseconds(50000)},
+    };
+    return profiles;
+}
+
+const NetworkProfile* NetworkProfile::byName(const std::string& name)
+{
+    for (const NetworkProfile& profile : presets())
+    {
+        if (profile.name == name) return &profile;
+    }
+    return nullptr;
+}
+
+// ======================
+// SimSocket
+// ======================
+
+SimSocket::SimSocket(SimNetwork* network, const sockaddr_in& addr, uint64_t seed)
+    : network_(network), addr_(addr), rng_(seed), arrivals_(0), closed_(false) {}
+
+SimSocket::~SimSocket()
+{
+    close();
+}
+
+void SimSocket::send(const sockaddr_in& dest, const std::vector<uint8_t>& data)
+{
+    metrics::add(metrics::Counter::PACKETS_SENT);
+    metrics::add(metrics::Counter::BYTES_SENT, data.size());
+    network_->route(*this, dest, data);
+}
+
+size_t SimSocket::receive(std::vector<uint8_t>& buffer, sockaddr_in& sender_addr)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true)
+    {
+        if (closed_) throw std::runtime_error("Failed to receive data");
+        if (inbox_.empty())
+        {
+            cv_.wait(lock);
+            continue;
+        }
+        auto due = inbox_.begin()->first.first;
+        if (due <= std::chrono::steady_clock::now()) break;
+        cv_.wait_until(lock, due);
+    }
+    auto node = inbox_.extract(inbox_.begin());
+    sender_addr = node.mapped().from;
+    buffer = std::move(node.mapped().data);
+    metrics::add(metrics::Counter::PACKETS_RECEIVED);
+    metrics::add(metrics::Counter::BYTES_RECEIVED, buffer.size());
+    return buffer.size();
+}
+
+void SimSocket::close()
+{
+    network_->detach(this);
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (closed_) return;
+        closed_ = true;
+        inbox_.clear();
+    }
+    cv_.notify_all();
+}
+
+void SimSocket::enqueue(std::chrono::steady_clock::time_point due, const sockaddr_in& from,
+                        const std::vector<uint8_t>& data)
+{
+    bool new_head;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (closed_) return;
+        auto it = inbox_.emplace(InboxKey(due, arrivals_++), InFlight{from, data}).first;
+        new_head = it == inbox_.begin();
+    }
+    if (new_head) cv_.notify_one();
+}
+
+// ======================
+// SimNetwork
+// ======================
+
+SimNetwork::SimNetwork(const NetworkProfile& profile, uint64_t seed)
+    : profile_(profile), seed_(seed), sent_(0), dropped_(0), duplicated_(0), unroutable_(0) {}
+
+SimSocket* SimNetwork::attach(const std::string& ip, uint16_t port)
+{
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0)
+    {
+        throw std::runtime_error("Invalid IP address");
+    }
+    uint64_t key = address_key(addr);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (endpoints_.count(key) != 0)
+    {
+        throw std::runtime_error("Failed to bind socket");
+    }
+    // splitmix-style spread so neighbouring ports don't get correlated streams
+    uint64_t stream = (seed_ ^ key) * 0x9E3779B97F4A7C15ull;
+    SimSocket* socket = new SimSocket(this, addr, stream ^ (stream >> 31));
+    endpoints_[key] = socket;
+    return socket;
+}
+
+void SimNetwork::detach(SimSocket* socket)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = endpoints_.find(address_key(socket->addr_));
+    if (it != endpoints_.end() && it->second == socket) endpoints_.erase(it);
+}
+
+SimNetwork::Stats SimNetwork::stats() const
+{
+    return {sent_.load(), dropped_.load(), duplicated_.load(), unroutable_.load()};
+}
+
+void SimNetwork::route(SimSocket& from, const sockaddr_in& dest, const std::vector<uint8_t>& data)
+{
+    sent_++;
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point due[2];
+    int copies = 0;
+    {
+        std::lock_guard<std::mutex> lock(from.rng_mutex_);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        if (coin(from.rng_) < profile_.loss)
+        {
+            dropped_++;
+            return;
+        }
+        copies = coin(from.rng_) < profile_.duplicate ? 2 : 1;
+        for (int i = 0; i < copies; i++)
+        {
+            microseconds delay = profile_.delay;
+            if (profile_.jitter.count() > 0)
+            {
+                std::uniform_int_distribution<int64_t> jitter(0, profile_.jitter.count() - 1);
+                delay += microseconds(jitter(from.rng_));
+            }
+            if (coin(from.rng_) < profile_.reorder) delay += profile_.reorder_delay;
+            due[i] = now + delay;
+        }
+    }
+    if (copies == 2) duplicated_++;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = endpoints_.find(address_key(dest));
+    if (it == endpoints_.end())
+    {
+        unroutable_++;
+        return;
+    }
+    for (int i = 0; i < copies; i++)
+    {
+        it->second->enqueue(due[i], from.addr_, data);
+    }
+}
@@ -1,13 +1,31 @@
 #include "network/udp_socket.hpp"
+#include "common/metrics.hpp"
+#include "common/threads.hpp"
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <iostream>
 #include <stdexcept>
 #include <tuple>
 
-UDPSocket::UDPSocket(uint16_t port) : port_(port) {
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+UDPSocket::UDPSocket(uint16_t port)
+    : port_(port), closed_(false), busy_poll_(0), gso_(false), gro_(false), gro_segment_(0), gro_offset_(0),
+      gro_source_() {
     socket_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
     if (socket_fd_ < 0) throw std::runtime_error("Failed to create socket");
     
@@ -25,14 +43,53 @@ UDPSocket::UDPSocket(uint16_t port) : port_(port) {
 
 UDPSocket::~UDPSocket() {
     close();
+    ::close(socket_fd_);
 }
 
+// ::close() alone does not wake a thread blocked in recvfrom on Linux; shutdown() does (it
+// reports ENOTCONN on an unconnected UDP socket but still marks it shut down and wakes it).
 void UDPSocket::close() 
 {
-    if (socket_fd_ >= 0) 
+    if (closed_.exchange(true)) return;
+    ::shutdown(socket_fd_, SHUT_RDWR);
+}
+
+void UDPSocket::setBusyPoll(uint32_t us)
+{
+    busy_poll_ = std::chrono::microseconds(us);
+#ifdef SO_BUSY_POLL
+    if (us > 0)
     {
-        ::close(socket_fd_);
-        socket_fd_ = -1;
+        int value = static_cast<int>(std::min<uint32_t>(us, 0x7FFFFFFF));
+        static std::atomic<bool> reported(false);
+        if (setsockopt(socket_fd_, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) < 0 &&
+            !reported.exchange(true))
+        {
+            std::cerr << "SO_BUSY_POLL=" << us << " not applied: " << std::strerror(errno)
+                      << " (spinning in user space only)" << std::endl;
+        }
+    }
+#endif
+}
+
+void UDPSocket::setSegmentationOffload(bool enabled)
+{
+    gso_ = false;
+    gro_ = false;
+    if (!enabled) return;
+    //UDP_SEGMENT=0的setsockopt只是探测内核是否支持GSO，真正的段长在每次sendmsg的cmsg里给
+    std::string missing;
+    int zero = 0;
+    if (setsockopt(socket_fd_, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0) gso_ = true;
+    else missing += std::string("GSO (") + std::strerror(errno) + ")";
+    int one = 1;
+    if (setsockopt(socket_fd_, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0) gro_ = true;
+    else missing += std::string(missing.empty() ? "" : ", ") + "GRO (" + std::strerror(errno) + ")";
+    //每个socket都会探测，但同一进程里结果相同，只报一次
+    static std::atomic<bool> reported(false);
+    if (!missing.empty() && !reported.exchange(true))
+    {
+        std::cerr << "UDP offload unavailable: " << missing << ", using one datagram per syscall" << std::endl;
     }
 }
 
@@ -48,13 +105,89 @@ void UDPSocket::send(const std::string& ip, uint16_t port, const std::vector<uin
     {
         throw std::runtime_error("Invalid IP address");
     }
-    
-    ssize_t sent = sendto(socket_fd_, data.data(), data.size(), 0,
-                          reinterpret_cast<sockaddr*>(&dest_addr), sizeof(dest_addr));
+    send(dest_addr, data);
+}
+
+void UDPSocket::send(const sockaddr_in& dest, const std::vector<uint8_t>& data)
+{
+    // MSG_NOSIGNAL: a send racing close() gets EPIPE, not a SIGPIPE that kills the process
+    ssize_t sent = sendto(socket_fd_, data.data(), data.size(), MSG_NOSIGNAL,
+                          reinterpret_cast<const sockaddr*>(&dest), sizeof(dest));
 
     if (sent < 0) {
         throw std::runtime_error("Failed to send data");
     }
+    metrics::add(metrics::Counter::PACKETS_SENT);
+    metrics::add(metrics::Counter::BYTES_SENT, static_cast<uint64_t>(sent));
+}
+
+// 分散的几段（包头 + 共享的消息体）由内核拼成一个datagram，用户态不复制
+void UDPSocket::sendGather(const sockaddr_in& dest, const std::vector<iovec>& parts)
+{
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_name = const_cast<sockaddr_in*>(&dest);
+    message.msg_namelen = sizeof(dest);
+    message.msg_iov = const_cast<iovec*>(parts.data());
+    message.msg_iovlen = parts.size();
+    ssize_t sent = sendmsg(socket_fd_, &message, MSG_NOSIGNAL);
+
+    if (sent < 0) {
+        throw std::runtime_error("Failed to send data");
+    }
+    metrics::add(metrics::Counter::PACKETS_SENT);
+    metrics::add(metrics::Counter::BYTES_SENT, static_cast<uint64_t>(sent));
+}
+
+// GSO：整个buffer一次sendmsg，内核（或网卡）按segment_size切成多个datagram
+void UDPSocket::sendSegmented(const sockaddr_in& dest, const uint8_t* data, size_t length, size_t segment_size)
+{
+    size_t segments = (length + segment_size - 1) / segment_size;
+    if (segments > 1 && gso_)
+    {
+        iovec part = {const_cast<uint8_t*>(data), length};
+        char control[CMSG_SPACE(sizeof(uint16_t))];
+        std::memset(control, 0, sizeof(control));
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_name = const_cast<sockaddr_in*>(&dest);
+        message.msg_namelen = sizeof(dest);
+        message.msg_iov = &part;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_UDP;
+        header->cmsg_type = UDP_SEGMENT;
+        header->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t size = static_cast<uint16_t>(segment_size);
+        std::memcpy(CMSG_DATA(header), &size, sizeof(size));
+
+        ssize_t sent = sendmsg(socket_fd_, &message, MSG_NOSIGNAL);
+        if (sent >= 0)
+        {
+            metrics::add(metrics::Counter::PACKETS_SENT, segments);
+            metrics::add(metrics::Counter::BYTES_SENT, static_cast<uint64_t>(sent));
+            metrics::add(metrics::Counter::GSO_SENDS);
+            return;
+        }
+        //EIO：出口设备不支持校验和卸载等；EINVAL/ENOPROTOOPT：内核不认这个cmsg。之后都逐个发
+        if (errno != EIO && errno != EINVAL && errno != ENOPROTOOPT) {
+            throw std::runtime_error("Failed to send data");
+        }
+        gso_ = false;
+    }
+    for (size_t offset = 0; offset < length; offset += segment_size)
+    {
+        size_t size = std::min(segment_size, length - offset);
+        ssize_t sent = sendto(socket_fd_, data + offset, size, MSG_NOSIGNAL,
+                              reinterpret_cast<const sockaddr*>(&dest), sizeof(dest));
+        if (sent < 0) {
+            throw std::runtime_error("Failed to send data");
+        }
+        metrics::add(metrics::Counter::PACKETS_SENT);
+        metrics::add(metrics::Counter::BYTES_SENT, static_cast<uint64_t>(sent));
+    }
 }
 
 // 创建一个buffer，用recvfrom阻塞接受数据，返回接收到的数据以及发送者的IP和端口
@@ -67,7 +200,7 @@ std::tuple<std::vector<uint8_t>, std::string, uint16_t> UDPSocket::receive()
     ssize_t received = recvfrom(socket_fd_, buffer.data(), buffer.size(), 0,
                                 reinterpret_cast<sockaddr*>(&sender_addr), &addr_len);
 
-    if (received < 0) 
+    if (received < 0 || closed_) 
     {
         throw std::runtime_error("Failed to receive data");
     }
@@ -79,4 +212,97 @@ std::tuple<std::vector<uint8_t>, std::string, uint16_t> UDPSocket::receive()
     uint16_t sender_port = ntohs(sender_addr.sin_port);
     
     return std::make_tuple(buffer, std::string(ip_str), sender_port);
-}
\ No newline at end of file
+}
+
+// One recvmsg into buffer (already sized); segment is the GRO segment size if the kernel
+// coalesced several datagrams into it, 0 otherwise.
+ssize_t UDPSocket::receiveOnce(std::vector<uint8_t>& buffer, sockaddr_in& sender_addr, int flags, size_t& segment)
+{
+    iovec part = {buffer.data(), buffer.size()};
+    char control[CMSG_SPACE(sizeof(int))];
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_name = &sender_addr;
+    message.msg_namelen = sizeof(sender_addr);
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    if (gro_)
+    {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+    }
+    ssize_t received = recvmsg(socket_fd_, &message, flags);
+    segment = 0;
+    if (received <= 0 || !gro_) return received;
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+    {
+        if (header->cmsg_level == SOL_UDP && header->cmsg_type == UDP_GRO)
+        {
+            int size = 0;
+            std::memcpy(&size, CMSG_DATA(header), sizeof(size));
+            if (size > 0 && static_cast<size_t>(size) < static_cast<size_t>(received)) segment = static_cast<size_t>(size);
+        }
+    }
+    return received;
+}
+
+size_t UDPSocket::receive(std::vector<uint8_t>& buffer, sockaddr_in& sender_addr)
+{
+    //GRO：上一次收到的合并buffer还没分发完，先逐个datagram交出去
+    if (gro_offset_ < gro_batch_.size())
+    {
+        size_t length = std::min(gro_segment_, gro_batch_.size() - gro_offset_);
+        auto begin = gro_batch_.begin() + static_cast<std::ptrdiff_t>(gro_offset_);
+        buffer.assign(begin, begin + static_cast<std::ptrdiff_t>(length));
+        sender_addr = gro_source_;
+        gro_offset_ += length;
+        metrics::add(metrics::Counter::PACKETS_RECEIVED);
+        metrics::add(metrics::Counter::BYTES_RECEIVED, length);
+        return length;
+    }
+
+    std::vector<uint8_t>& target = gro_ ? gro_batch_ : buffer;
+    target.resize(65536);
+    size_t segment = 0;
+
+    ssize_t received = -1;
+    if (busy_poll_.count() > 0)
+    {
+        //忙轮询：先用非阻塞recvmsg自旋busy_poll_，期间没有数据再退回阻塞recvmsg
+        auto deadline = std::chrono::steady_clock::now() + busy_poll_;
+        do
+        {
+            received = receiveOnce(target, sender_addr, MSG_DONTWAIT, segment);
+            if (received >= 0 || errno != EAGAIN || closed_) break;
+            cpuRelax();
+        } while (std::chrono::steady_clock::now() < deadline);
+    }
+    if (received < 0 && !closed_)
+    {
+        received = receiveOnce(target, sender_addr, 0, segment);
+    }
+
+    if (received < 0 || closed_)
+    {
+        target.clear();
+        throw std::runtime_error("Failed to receive data");
+    }
+    target.resize(static_cast<size_t>(received));
+    if (!gro_)
+    {
+        metrics::add(metrics::Counter::PACKETS_RECEIVED);
+        metrics::add(metrics::Counter::BYTES_RECEIVED, static_cast<uint64_t>(received));
+        return static_cast<size_t>(received);
+    }
+    if (segment > 0) metrics::add(metrics::Counter::GRO_RECEIVES);
+    gro_segment_ = segment > 0 ? segment : static_cast<size_t>(received);
+    gro_source_ = sender_addr;
+    gro_offset_ = 0;
+    if (received == 0)
+    {
+        buffer.clear();
+        metrics::add(metrics::Counter::PACKETS_RECEIVED);
+        return 0;
+    }
+    return receive(buffer, sender_addr);
+}
@@ -1,8 +1,12 @@
 #include "perfectlink/perfect_link_app.hpp"
+#include "common/metrics.hpp"
+#include "common/threads.hpp"
+#include "common/tracepoints.hpp"
 #include <iostream> 
 #include <algorithm>
 #include <type_traits>
 #include <unordered_map>
+#include <stdexcept>
 
 
 namespace milestone1 
@@ -12,8 +16,12 @@ namespace milestone1
 // Sender 
 // ======================
 
-Sender::Sender(UDPSocket* socket, uint32_t my_id, const Host& receiver, Logger* logger)
-    : socket_(socket), my_id_(my_id), receiver_(receiver), logger_(logger), running_(false) {}
+Sender::Sender(Transport* socket, uint32_t my_id, const Peer& receiver, Logger* logger,
+               Receiver* ack_source, const LatencyTracer* tracer)
+    : socket_(socket), my_id_(my_id), receiver_(receiver), logger_(logger), ack_source_(ack_source),
+      tracer_(tracer), pending_queue_(std::deque<PendingMessage, PoolAllocator<PendingMessage>>(
+                           PoolAllocator<PendingMessage>(&queue_pool_))),
+      unacked_messages_(PoolAllocator<UnackedEntry>(&unacked_pool_)), next_payload_seq_(1), wait_aborted_(false), spin_(0), running_(false) {}
 
 Sender::~Sender() 
 {
@@ -25,8 +33,6 @@ void Sender::start()
     running_ = true;
     //线程3：sender发送数据包
     send_thread_ = std::thread(&Sender::sendLoop, this);
-    //线程5：sender接收ACK包
-    ack_receive_thread_ = std::thread(&Sender::ackReceiveLoop, this);
     //线程4: sender重传数据包
     retransmit_thread_ = std::thread(&Sender::retransmitLoop, this);
 }
@@ -36,11 +42,9 @@ void Sender::stop()
     running_ = false;
     //强制唤醒休眠的sendLoop()线程，让该线程可以检查到 running_ = false 条件，从而安全地退出它的主循环。
     queue_cv_.notify_all();
+    abortWait();
     //确保retransmitLoop()线程不会因为等待超时而永远阻塞，唤醒它以便它能检查running_标志并退出
     timeout_cv_.notify_all();
-    
-    //ackReceiveLoop线程在socket_->receive()阻塞等待数据，deatch强制中断退出（通过关闭socket）
-    if (ack_receive_thread_.joinable()) ack_receive_thread_.detach();
 
     //retransmitLoop在timeout_cv_.wait_until被唤醒后会检查running_退出循环，所以用join等它处理完再退出更安全。
     if (retransmit_thread_.joinable()) retransmit_thread_.join();
@@ -49,12 +53,12 @@ void Sender::stop()
     if (send_thread_.joinable()) send_thread_.join();
 }
 
-void Sender::send(uint32_t original_sender_id, uint32_t seq_number) 
+void Sender::send(uint32_t original_sender_id, uint32_t seq_number, SharedPayload payload) 
 {
     {
         std::lock_guard<std::mutex> lock(queue_mutex_);
-        pending_queue_.push({original_sender_id, seq_number});
-        if (original_sender_id == my_id_) 
+        pending_queue_.push({original_sender_id, seq_number, std::move(payload)});
+        if (original_sender_id == my_id_ && logger_ != nullptr) 
         {
             logger_->logBroadcast(seq_number);
         }
@@ -62,6 +66,18 @@ void Sender::send(uint32_t original_sender_id, uint32_t seq_number)
     queue_cv_.notify_one();
 }
 
+uint32_t Sender::sendPayload(std::vector<uint8_t> payload) 
+{
+    uint32_t seq;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        seq = next_payload_seq_++;
+        pending_queue_.push({my_id_, seq, std::make_shared<const std::vector<uint8_t>>(std::move(payload))});
+    }
+    queue_cv_.notify_one();
+    return seq;
+}
+
 bool Sender::allMessagesAcked() const 
 {
     std::lock_guard<std::mutex> lock1(queue_mutex_);
@@ -71,31 +87,57 @@ bool Sender::allMessagesAcked() const
 
 void Sender::waitUntilAllAcked() 
 {
-    int wait_count = 0;
-    while (running_ && !allMessagesAcked()) 
+    //handleAck清空unacked_messages_时唤醒；pending_queue_的消息还没发出去时unacked可能暂时为空，所以定时重查
+    while (running_ && !wait_aborted_ && !allMessagesAcked()) 
     {
-        if (wait_count % 20 == 0) 
-        {  // Print every 1 second
-            std::lock_guard<std::mutex> lock1(queue_mutex_);
-            std::lock_guard<std::mutex> lock2(data_mutex_);
-        }
-        wait_count++;
+        std::unique_lock<std::mutex> lock(data_mutex_);
+        acked_cv_.wait_for(lock, std::chrono::milliseconds(10), [this] {
+            return !running_ || wait_aborted_ || unacked_messages_.empty();
+        });
     }
 }
 
+void Sender::abortWait() 
+{
+    wait_aborted_ = true;
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    acked_cv_.notify_all();
+}
+
 void Sender::sendLoop() 
 {
+    ThreadScope scope(placement_, ThreadRole::SEND, receiver_.index, receiver_.id);
+    //batch和out在循环外复用，保留capacity
+    std::vector<PendingMessage> batch;
+    OutgoingPacket out;
+    batch.reserve(MAX_BURST_PACKETS * MAX_BATCH_SIZE);
     while (running_) 
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (spin_.count() > 0 && pending_queue_.empty() && running_) 
+        {
+            //忙轮询模式：睡眠之前先自旋spin_，每次短暂加锁检查队列
+            auto deadline = std::chrono::steady_clock::now() + spin_;
+            lock.unlock();
+            while (std::chrono::steady_clock::now() < deadline) 
+            {
+                cpuRelax();
+                lock.lock();
+                if (!pending_queue_.empty() || !running_) break;
+                lock.unlock();
+            }
+            if (!lock.owns_lock()) lock.lock();
+        }
         queue_cv_.wait(lock, [this] { return !pending_queue_.empty() || !running_; });
         
         if (!running_) break;
         
-        std::vector<std::pair<uint32_t, uint32_t>> batch;
-        while (!pending_queue_.empty() && batch.size() < MAX_BATCH_SIZE)
+        //积压时一次取多个包的量，transmit按原始发送者切成DATA包，再一起分段发送(GSO)
+        batch.clear();
+        metrics::record(metrics::Histogram::SEND_QUEUE_DEPTH, pending_queue_.size());
+        while (!pending_queue_.empty() && batch.size() < MAX_BURST_PACKETS * MAX_BATCH_SIZE)
         {
-            batch.push_back(pending_queue_.front());
+            batch.push_back(std::move(pending_queue_.front()));
             pending_queue_.pop();
         }
         lock.unlock();
@@ -105,27 +147,117 @@ void Sender::sendLoop()
         auto now = std::chrono::steady_clock::now();
         {
             std::lock_guard<std::mutex> data_lock(data_mutex_);
-            for (const auto& [sender_id, seq] : batch) 
+            for (const PendingMessage& message : batch) 
             {
-                unacked_messages_[seq] = SentMessage(seq, now);
-                timeout_queue_.push({now + TIMEOUT, seq});
+                unacked_messages_[messageKey(message.sender_id, message.seq_number)] =
+                    SentMessage(message.sender_id, message.seq_number, now, message.payload);
+                timeout_queue_.push({now + TIMEOUT, message.sender_id, message.seq_number});
             }
+            metrics::record(metrics::Histogram::UNACKED_DEPTH, unacked_messages_.size());
         }
         timeout_cv_.notify_one();
         
-        std::vector<uint32_t> seq_batch;
-        uint32_t batch_sender_id = batch[0].first;
-        for (const auto& [sender_id, seq] : batch) {
-            seq_batch.push_back(seq);
+        transmit(out, batch.data(), batch.size(), false);
+        batch.clear();  // drop the payload references now, not at the next batch
+    }
+}
+
+// Sends out.burst and empties it. A run of equal-sized datagrams, plus one shorter one to
+// close it (all that GSO allows), goes out in one sendSegmented call.
+static void send_burst(Transport* socket, const sockaddr_in& dest, OutgoingPacket& out)
+{
+    const std::vector<size_t>& sizes = out.burst_sizes;
+    size_t offset = 0;
+    size_t begin = 0;
+    while (begin < sizes.size()) 
+    {
+        size_t segment = sizes[begin];
+        size_t bytes = segment;
+        size_t end = begin + 1;
+        while (end < sizes.size() && end - begin < Transport::MAX_SEGMENTS && sizes[end] <= segment &&
+               bytes + sizes[end] <= Transport::MAX_SEGMENTED_BYTES) 
+        {
+            bytes += sizes[end++];
+            if (sizes[end - 1] < segment) break;
+        }
+        socket->sendSegmented(dest, out.burst.data() + offset, bytes, segment);
+        offset += bytes;
+        begin = end;
+    }
+    out.burst.clear();
+    out.burst_sizes.clear();
+}
+
+// messages come in runs of one original sender (queue order, or sorted for retransmission).
+// Each run becomes DATA packets of up to MAX_BATCH_SIZE seqs, or payload packets of about
+// MAX_PAYLOAD_PACKET_BYTES and at most Packet::MAX_ENTRIES messages, whose bodies go to the
+// socket straight from the shared buffers.
+// DATA packets are collected and sent together at the end, so that a backlog or a burst of
+// retransmissions costs one segmented send rather than a sendto per packet.
+void Sender::transmit(OutgoingPacket& out, const PendingMessage* messages, size_t count, bool retransmission) 
+{
+    //send和retransmit两个线程都会调用transmit，各自传入自己的OutgoingPacket
+    Packet& packet = out.packet;
+    bool broadcast = ack_source_ != nullptr;
+    size_t first = 0;
+    while (first < count) 
+    {
+        uint32_t sender_id = messages[first].sender_id;
+        bool with_payload = messages[first].payload != nullptr;
+        size_t last = first;
+        size_t bytes = 0;
+        while (last < count && messages[last].sender_id == sender_id &&
+               (messages[last].payload != nullptr) == with_payload) 
+        {
+            if (with_payload) 
+            {
+                if (last > first && bytes + messages[last].payload->size() > MAX_PAYLOAD_PACKET_BYTES) break;
+                if (last - first == Packet::MAX_ENTRIES) break;  // small bodies: the u8 seq count runs out first
+                bytes += messages[last].payload->size();
+            }
+            else if (last - first == MAX_BATCH_SIZE) 
+            {
+                break;
+            }
+            last++;
         }
         
-        Packet packet = Packet::createDataPacket(batch_sender_id, seq_batch);
-        socket_->send(receiver_.ip, receiver_.port, packet.serialize());
+        if (with_payload) packet.type = broadcast ? MessageType::BROADCAST_PAYLOAD : MessageType::PERFECT_LINK_PAYLOAD;
+        else packet.type = broadcast ? MessageType::BROADCAST_DATA : MessageType::PERFECT_LINK_DATA;
+        packet.sender_id = sender_id;
+        packet.seq_numbers.clear();
+        packet.payloads.clear();
+        for (size_t i = first; i < last; i++) 
+        {
+            packet.seq_numbers.push_back(messages[i].seq_number);
+            if (with_payload) packet.payloads.push_back(messages[i].payload);
+        }
+        packet.acks.clear();
+        packet.stamps.clear();
+        if (broadcast) 
+        {
+            ack_source_->takePendingAcks(receiver_.index, packet.acks);
+            metrics::add(metrics::Counter::ACKS_PIGGYBACKED, packet.acks.size());
+            if (tracer_ != nullptr) tracer_->attachStamps(sender_id, packet.seq_numbers, packet.stamps);
+        }
+        if (retransmission) DA_PROBE4(retransmit, receiver_.id, sender_id, packet.seq_numbers.front(), last - first);
+        else DA_PROBE4(packet_send, receiver_.id, sender_id, packet.seq_numbers.front(), last - first);
+        metrics::add(metrics::Counter::DATA_PACKETS_SENT);
+        metrics::addPeer(metrics::PeerCounter::PACKETS_SENT, receiver_.index);
+        if (with_payload) socket_->sendGather(receiver_.addr, out.gather());
+        else out.appendToBurst();
+        first = last;
     }
+    packet.payloads.clear();
+    send_burst(socket_, receiver_.addr, out);
 }
 
 void Sender::retransmitLoop() 
 {
+    ThreadScope scope(placement_, ThreadRole::RETRANSMIT, receiver_.index, receiver_.id);
+    std::vector<PendingMessage> to_retransmit;
+    OutgoingPacket out;
+    to_retransmit.reserve(MAX_BURST_PACKETS * MAX_BATCH_SIZE);
     while (running_) 
     {
         std::unique_lock<std::mutex> lock(data_mutex_);
@@ -146,69 +278,85 @@ void Sender::retransmitLoop()
         
         if (wait_result == std::cv_status::timeout) {
             auto now = std::chrono::steady_clock::now();
-            std::vector<uint32_t> to_retransmit;
+            to_retransmit.clear();
             
-            while (!timeout_queue_.empty() && to_retransmit.size() < MAX_BATCH_SIZE) {
+            while (!timeout_queue_.empty() && to_retransmit.size() < MAX_BURST_PACKETS * MAX_BATCH_SIZE) {
                 auto e = timeout_queue_.top();
                 if (e.timeout_time > now) break;
                 
                 timeout_queue_.pop();
                 
-                auto it = unacked_messages_.find(e.seq_number);
+                auto it = unacked_messages_.find(messageKey(e.sender_id, e.seq_number));
                 if (it == unacked_messages_.end()) continue;
                 
-                to_retransmit.push_back(e.seq_number);
+                to_retransmit.push_back({e.sender_id, e.seq_number, it->second.payload});
                 it->second.last_sent = now;
                 it->second.retransmit_count++;
-                timeout_queue_.push({now + TIMEOUT, e.seq_number});
+                timeout_queue_.push({now + TIMEOUT, e.sender_id, e.seq_number});
             }
             
             if (!to_retransmit.empty()) {
                 lock.unlock();
-                Packet packet = Packet::createDataPacket(my_id_, to_retransmit);
-                socket_->send(receiver_.ip, receiver_.port, packet.serialize());
+                metrics::add(metrics::Counter::RETRANSMISSIONS, to_retransmit.size());
+                metrics::addPeer(metrics::PeerCounter::RETRANSMISSIONS, receiver_.index, to_retransmit.size());
+                //按原始发送者排序，transmit再按发送者切成DATA包（std::sort不像stable_sort那样申请临时缓冲）
+                std::sort(to_retransmit.begin(), to_retransmit.end());
+                transmit(out, to_retransmit.data(), to_retransmit.size(), true);
+                to_retransmit.clear();
             }
         }
     }
 }
 
-void Sender::ackReceiveLoop() 
+// ACK包由app的receiveLoop按来源peer分发到这里，不再需要单独的ACK接收线程
+void Sender::handleAck(const Packet& packet) 
 {
-    while (running_) 
+    auto now = std::chrono::steady_clock::now();
+    DA_PROBE2(ack_receive, receiver_.id, packet.seq_numbers.size() + packet.acks.size());
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    //perfect link的ACK只带seq，原始发送者就是自己；broadcast的ACK带(origin, seq)
+    if (packet.type == MessageType::PERFECT_LINK_ACK) 
     {
-        //线程5：阻塞接收ACK包，这里的socket_就是sender_socket_
-        try 
+        for (uint32_t seq : packet.seq_numbers) 
         {
-            auto [data, sender_ip, sender_port] = socket_->receive();
-            Packet packet = Packet::deserialize(data);
-            
-            if (packet.type == MessageType::PERFECT_LINK_ACK) 
-            {
-                std::lock_guard<std::mutex> lock(data_mutex_);
-                for (uint32_t seq : packet.seq_numbers) 
-                {
-                    unacked_messages_.erase(seq);
-                }
-                //有ACK收到，可能会使得某些消息不再需要重传，唤醒retransmitLoop线程，
-                //检查更新后的unacked_messages_是否还有timeout_queue_中需要重传的消息，从而重新计算下一个超时
-                timeout_cv_.notify_one();
-            }
-        } 
-        //当运行app：：shutdown时，关闭这个socket_以中断阻塞的receive调用，抛出异常
-        catch (const std::exception& e) 
-        {
-            if (!running_) break;
+            clearAcked(messageKey(my_id_, seq), now);
         }
     }
-    std::cout << "[DEBUG] ackReceiveLoop finished" << std::endl;
+    for (const Message& ack : packet.acks) 
+    {
+        clearAcked(messageKey(ack.sender_id, ack.seq_number), now);
+    }
+    //有ACK收到，可能会使得某些消息不再需要重传，唤醒retransmitLoop线程，
+    //检查更新后的unacked_messages_是否还有timeout_queue_中需要重传的消息，从而重新计算下一个超时
+    timeout_cv_.notify_one();
+    if (unacked_messages_.empty()) acked_cv_.notify_all();
+}
+
+// caller holds data_mutex_. RTT samples skip retransmitted messages: their ACK can't be
+// matched to a particular copy (Karn's rule).
+void Sender::clearAcked(uint64_t key, std::chrono::steady_clock::time_point now) 
+{
+    auto it = unacked_messages_.find(key);
+    if (it == unacked_messages_.end()) return;
+    metrics::add(metrics::Counter::ACKS_RECEIVED);
+    if (it->second.retransmit_count == 0) 
+    {
+        metrics::record(metrics::Histogram::ACK_RTT_US, metrics::microsSince(it->second.last_sent, now));
+    }
+    unacked_messages_.erase(it);
 }
 
 // ====================
 // Receiver 
 // ====================
 
-Receiver::Receiver(UDPSocket* socket, Logger* logger)
-    : socket_(socket), logger_(logger), flush_running_(false) {}
+Receiver::Receiver(Transport* socket, const PeerDirectory& peers, Logger* logger, bool piggyback)
+    : socket_(socket), peers_(peers), logger_(logger), piggyback_(piggyback),
+      pending_acks_(peers.size()), flush_running_(false) 
+{
+    //handle在积压到一个包之前不会发送，所以积压不超过一个ACK包加一个DATA包的seq数
+    for (PendingAcks& pending : pending_acks_) pending.acks.reserve(2 * MAX_ACKS_PER_PACKET);
+}
 
 Receiver::~Receiver() {
     stop();
@@ -228,65 +376,116 @@ void Receiver::stop()
     if (flush_thread_.joinable()) flush_thread_.join();
 }
 
-void Receiver::handle(const Packet& packet, const std::string& sender_ip, uint16_t sender_port) 
+void Receiver::handle(const Packet& packet, uint32_t peer_index) 
 {
-    if (packet.type != MessageType::PERFECT_LINK_DATA) return;
+    if (packet.type != MessageType::PERFECT_LINK_DATA && packet.type != MessageType::BROADCAST_DATA &&
+        !packet.hasPayloads()) return;
     
-    std::string key = sender_ip + ":" + std::to_string(static_cast<unsigned int>(sender_port));
     std::lock_guard<std::mutex> lock(mtx_);
+    PendingAcks& pending = pending_acks_[peer_index];
+    if (pending.acks.empty()) 
+    {
+        pending.oldest = std::chrono::steady_clock::now();
+    }
     
     uint32_t sender_id = packet.sender_id;
-    std::set<uint32_t>& delivered = delivered_messages_[sender_id];
-    
-    if (delivered.size() >= MAX_DELIVERED_WINDOW) 
+    for (uint32_t seq : packet.seq_numbers) 
     {
-        delivered.erase(delivered.begin());
+        pending.acks.emplace_back(sender_id, seq);
     }
     
-    for (uint32_t seq : packet.seq_numbers) 
+    if (logger_ != nullptr) 
     {
-        if (delivered.find(seq) == delivered.end()) 
+        DeliveredSeqs& delivered =
+            delivered_messages_.try_emplace(sender_id, PoolAllocator<uint32_t>(&delivered_pool_)).first->second;
+        
+        for (uint32_t seq : packet.seq_numbers) 
         {
+            if (seq <= delivered.watermark || delivered.above.count(seq) != 0) 
+            {
+                DA_PROBE2(duplicate, sender_id, seq);
+                continue;
+            }
+            DA_PROBE2(deliver, sender_id, seq);
             logger_->logDelivery(sender_id, seq);
-            delivered.insert(seq);
+            //连续的部分并入watermark，above里只留第一个空洞之后的seq（节点在池里循环使用）
+            if (seq != delivered.watermark + 1) 
+            {
+                delivered.above.insert(seq);
+                continue;
+            }
+            delivered.watermark++;
+            while (!delivered.above.empty() && *delivered.above.begin() == delivered.watermark + 1) 
+            {
+                delivered.above.erase(delivered.above.begin());
+                delivered.watermark++;
+            }
         }
-        pending_acks_[key].push_back(seq);
     }
     
-    if (pending_acks_[key].size() >= ACK_BATCH_SIZE) 
+    //piggyback模式下ACK由反方向的DATA带回，只有积压超过一个包的容量才立即发
+    size_t batch_limit = piggyback_ ? MAX_ACKS_PER_PACKET : ACK_BATCH_SIZE;
+    if (pending.acks.size() >= batch_limit) 
+    {
+        sendAcks(peer_index, pending.acks);
+    }
+}
+
+void Receiver::takePendingAcks(uint32_t peer_index, std::vector<Message>& out) 
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<Message>& acks = pending_acks_[peer_index].acks;
+    size_t count = std::min(acks.size(), MAX_ACKS_PER_PACKET - std::min(out.size(), MAX_ACKS_PER_PACKET));
+    out.insert(out.end(), acks.begin(), acks.begin() + static_cast<std::ptrdiff_t>(count));
+    acks.erase(acks.begin(), acks.begin() + static_cast<std::ptrdiff_t>(count));
+}
+
+// caller holds mtx_
+void Receiver::sendAcks(uint32_t peer_index, std::vector<Message>& ack_list)
+{
+    const sockaddr_in& dest = peers_.at(peer_index).addr;
+    size_t max_batch = piggyback_ ? MAX_ACKS_PER_PACKET : ACK_BATCH_SIZE;
+    Packet& ack = ack_out_.packet;
+    ack.sender_id = 0;
+    while (!ack_list.empty()) 
     {
-        std::vector<uint32_t> batch(pending_acks_[key].begin(), 
-                                     pending_acks_[key].begin() + ACK_BATCH_SIZE);
-        Packet ack = Packet::createAckPacket(batch);
-        socket_->send(sender_ip, sender_port, ack.serialize());
-        pending_acks_[key].erase(pending_acks_[key].begin(), 
-                                  pending_acks_[key].begin() + ACK_BATCH_SIZE);
+        size_t batch_size = std::min(ack_list.size(), max_batch);
+        ack.seq_numbers.clear();
+        ack.acks.clear();
+        if (piggyback_) 
+        {
+            ack.type = MessageType::BROADCAST_ACK;
+            ack.acks.assign(ack_list.begin(), ack_list.begin() + static_cast<std::ptrdiff_t>(batch_size));
+        } 
+        else 
+        {
+            ack.type = MessageType::PERFECT_LINK_ACK;
+            for (size_t i = 0; i < batch_size; i++) ack.seq_numbers.push_back(ack_list[i].seq_number);
+        }
+        metrics::add(metrics::Counter::ACK_PACKETS_SENT);
+        metrics::record(metrics::Histogram::ACK_BATCH_SIZE, batch_size);
+        ack_out_.appendToBurst();
+        ack_list.erase(ack_list.begin(), ack_list.begin() + static_cast<std::ptrdiff_t>(batch_size));
     }
+    send_burst(socket_, dest, ack_out_);
 }
 
 void Receiver::flushLoop() 
 {
+    ThreadScope scope(placement_, ThreadRole::FLUSH);
     while (flush_running_) 
     {
         std::this_thread::sleep_for(ACK_FLUSH_TIMEOUT);
         
+        auto deadline = std::chrono::steady_clock::now() - ACK_FLUSH_TIMEOUT;
         std::lock_guard<std::mutex> lock(mtx_);
-        for (auto& [key, ack_list] : pending_acks_) 
+        for (uint32_t i = 0; i < pending_acks_.size(); i++) 
         {
-            if (ack_list.empty()) continue;
-            
-            size_t colon_pos = key.find(':');
-            std::string sender_ip = key.substr(0, colon_pos);
-            uint16_t sender_port = static_cast<uint16_t>(std::stoul(key.substr(colon_pos + 1)));
-            
-            while (!ack_list.empty()) 
-            {
-                size_t batch_size = std::min(ack_list.size(), static_cast<size_t>(ACK_BATCH_SIZE));
-                std::vector<uint32_t> batch(ack_list.begin(), ack_list.begin() + batch_size);
-                Packet ack = Packet::createAckPacket(batch);
-                socket_->send(sender_ip, sender_port, ack.serialize());
-                ack_list.erase(ack_list.begin(), ack_list.begin() + batch_size);
-            }
+            PendingAcks& pending = pending_acks_[i];
+            if (pending.acks.empty()) continue;
+            //piggyback模式：还没等满ACK_FLUSH_TIMEOUT的ACK留给反方向的DATA带走
+            if (piggyback_ && pending.oldest > deadline) continue;
+            sendAcks(i, pending.acks);
         }
     }
 }
@@ -294,22 +493,10 @@ void Receiver::flushLoop()
 void Receiver::flushAllPendingAcks() 
 {
     std::lock_guard<std::mutex> lock(mtx_);
-    for (auto& [key, ack_list] : pending_acks_) {
-        if (ack_list.empty()) continue;
-        
-        size_t colon_pos = key.find(':');
-        std::string sender_ip = key.substr(0, colon_pos);
-        uint16_t sender_port = static_cast<uint16_t>(std::stoul(key.substr(colon_pos + 1)));
-        
-        while (!ack_list.empty()) {
-            size_t batch_size = std::min(ack_list.size(), static_cast<size_t>(ACK_BATCH_SIZE));
-            std::vector<uint32_t> batch(ack_list.begin(), ack_list.begin() + batch_size);
-            Packet ack = Packet::createAckPacket(batch);
-            socket_->send(sender_ip, sender_port, ack.serialize());
-            ack_list.erase(ack_list.begin(), ack_list.begin() + batch_size);
-        }
+    for (uint32_t i = 0; i < pending_acks_.size(); i++) 
+    {
+        if (!pending_acks_[i].acks.empty()) sendAcks(i, pending_acks_[i].acks);
     }
-    pending_acks_.clear();
 }
 
 // =============================
@@ -317,27 +504,49 @@ void Receiver::flushAllPendingAcks()
 // =====================
 
 PerfectLinkApp::PerfectLinkApp(uint32_t my_id, const std::vector<Host>& hosts,
-                               uint32_t m, uint32_t receiver_id, const std::string& output_path)
-    : my_id_(my_id), hosts_(hosts), m_(m), receiver_id_(receiver_id), running_(false) 
+                               uint32_t m, uint32_t receiver_id, const std::string& output_path,
+                               const RuntimeOptions& options, Transport* transport)
+    : my_id_(my_id), peers_(hosts), m_(m), receiver_id_(receiver_id), options_(options), capture_(nullptr),
+      running_(false) 
 {
+    if (peers_.indexOfId(my_id_) == PeerDirectory::INVALID_INDEX) 
+    {
+        throw std::runtime_error("Process id not found in hosts file");
+    }
+    const Host& my_host = peers_.at(peers_.indexOfId(my_id_)).host;
+    //同一个socket收发DATA和ACK，线程1按包类型分发给receiver或sender
+    socket_ = transport;
+    if (socket_ == nullptr) 
+    {
+        UDPSocket* udp = new UDPSocket(my_host.port);
+        udp->setBusyPoll(options_.busy_poll_us);
+        udp->setSegmentationOffload(options_.segmentation_offload);
+        socket_ = udp;
+    }
 
-    Host my_host = findHost(my_id_);
-    //receiver_socket_是线程1，接收DATA包，sender_socket_是线程5，接收ACK包
-    receiver_socket_ = new UDPSocket(my_host.port);
-    sender_socket_ = new UDPSocket(static_cast<uint16_t>(my_host.port + 1000));
-
-    logger_ = new Logger(output_path);
+    logger_ = new Logger(output_path, options.log_format);
     
     if (my_id_ != receiver_id_) 
     {
-        Host receiver_host = findHost(receiver_id_);
-        sender_ = new Sender(sender_socket_, my_id_, receiver_host, logger_);
+        uint32_t receiver_index = peers_.indexOfId(receiver_id_);
+        if (receiver_index == PeerDirectory::INVALID_INDEX) 
+        {
+            throw std::runtime_error("Receiver id not found in hosts file");
+        }
+        sender_ = new Sender(socket_, my_id_, peers_.at(receiver_index), logger_);
+        sender_->setSpinBeforeBlock(std::chrono::microseconds(options_.busy_poll_us));
+        sender_->setPlacement(options_.thread_placement);
     } 
     else 
     {
         sender_ = nullptr;
     }
-    receiver_ = new Receiver(receiver_socket_, logger_);
+    receiver_ = new Receiver(socket_, peers_, logger_);
+    receiver_->setPlacement(options_.thread_placement);
+    if (options.capture_enabled) 
+    {
+        capture_ = new PacketCaptureWriter(output_path + ".capture", my_id_, peers_);
+    }
 }
 
 PerfectLinkApp::~PerfectLinkApp() 
@@ -346,8 +555,8 @@ PerfectLinkApp::~PerfectLinkApp()
     delete receiver_;
     delete sender_;
     delete logger_;
-    delete sender_socket_;
-    delete receiver_socket_;
+    delete capture_;
+    delete socket_;
 }
 
 void PerfectLinkApp::run() 
@@ -378,38 +587,42 @@ void PerfectLinkApp::run()
     }
 }
 
+void PerfectLinkApp::interrupt()
+{
+    if (sender_ != nullptr) sender_->abortWait();
+}
+
 void PerfectLinkApp::shutdown()
 {
     running_ = false;
-    //线程1：receiverloop在使用这个receiver_socket_，关闭它以中断阻塞的receive调用
-    receiver_socket_->close();
-    //线程5：sender的ackreceiveloop在使用这个sender_socket_，关闭它以中断阻塞的receive调用
-    sender_socket_->close();
+    //先停止会用socket_发送的线程2/3/4，再关闭socket_
     //线程2：receiver停止flushack线程
     receiver_->stop();
     if (sender_ != nullptr) sender_->stop();
-    if (receive_thread_.joinable()) receive_thread_.detach();
+    //线程1：receiveLoop在使用这个socket_，close()会唤醒阻塞的receive调用（抛异常），然后join等它退出
+    socket_->close();
+    if (receive_thread_.joinable()) receive_thread_.join();
     
-    logger_->flush();
+    logger_->close();
 }
 
 
 void PerfectLinkApp::receiveLoop() 
 {
-    //线程1：receiver接受者，阻塞接收数据包
+    //线程1：阻塞接收DATA和ACK包，按类型分发
+    ThreadScope scope(options_.thread_placement, ThreadRole::RECEIVE);
+    std::vector<uint8_t> data;
+    sockaddr_in sender_addr;
     while (running_)
     {
         try 
         {
-            auto [data, sender_ip, sender_port] = receiver_socket_->receive();
-            Packet packet = Packet::deserialize(data);
-            if (packet.type == MessageType::PERFECT_LINK_DATA) 
-            {
-                receiver_->handle(packet, sender_ip, sender_port);
-            }
+            socket_->receive(data, sender_addr);
+            if (capture_ != nullptr) capture_->record(sender_addr, data);
+            handleDatagram(data, sender_addr);
         } 
         catch (const std::exception&)
-        //当app：：shutdown时，receiver_socket_被关闭，会抛出异常，跳出阻塞的receive调用
+        //当app：：shutdown时，socket_被关闭，会抛出异常，跳出阻塞的receive调用
         {
             if (!running_) 
             {
@@ -420,16 +633,21 @@ void PerfectLinkApp::receiveLoop()
     }
 }
 
-Host PerfectLinkApp::findHost(uint32_t id) const 
+void PerfectLinkApp::handleDatagram(const std::vector<uint8_t>& data, const sockaddr_in& sender_addr) 
 {
-    for (const Host& host : hosts_) 
+    uint32_t peer_index = peers_.lookup(sender_addr);
+    if (peer_index == PeerDirectory::INVALID_INDEX) return;
+    metrics::addPeer(metrics::PeerCounter::PACKETS_RECEIVED, peer_index);
+
+    Packet::deserializeInto(data, rx_packet_);
+    if (rx_packet_.type == MessageType::PERFECT_LINK_DATA) 
     {
-        if (host.id == id) 
-        {
-            return host;
-        }
+        receiver_->handle(rx_packet_, peer_index);
+    }
+    else if (rx_packet_.type == MessageType::PERFECT_LINK_ACK && sender_ != nullptr) 
+    {
+        sender_->handleAck(rx_packet_);
     }
-    return Host();
 }
 
-}
\ No newline at end of file
+}
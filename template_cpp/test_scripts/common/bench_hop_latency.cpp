@@ -0,0 +1,125 @@
+// bench_hop_latency.cpp - one network hop (serialize -> sendto -> recvfrom -> deserialize) on loopback
+// Compile: g++ -O2 -std=c++17 -pthread -I../../src/include bench_hop_latency.cpp ../../src/src/common/*.cpp ../../src/src/network/*.cpp -o bench_hop_latency
+// Run: ./bench_hop_latency [rounds] [spin_us] [cpu_a] [cpu_b]      (defaults: 20000 50 0 1)
+//
+// Ping-pong of an 8-seq PERFECT_LINK_DATA packet between two UDPSockets in this process; the
+// echo side deserializes and answers with the ACK packet, like Receiver does. A hop is half a
+// round trip. Three modes:
+//   blocking     recvfrom sleeps in the kernel (the default)
+//   busy         UDPSocket::setBusyPoll(spin_us): MSG_DONTWAIT + pause spin for up to spin_us,
+//                then a blocking recvfrom (DA_BUSY_POLL)
+//   busy+pinned  busy, and the two threads pinned to cpu_a / cpu_b (DA_BUSY_POLL_CPU)
+// Busy polling only pays off with a spare core per spinning thread; on fewer cores than
+// threads the spinners steal each other's time slices and "busy" gets slower, not faster.
+
+#include "common/threads.hpp"
+#include "network/message.hpp"
+#include "network/udp_socket.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static constexpr uint16_t PORT_A = 12100;
+static constexpr uint16_t PORT_B = 12101;
+static constexpr uint32_t WARMUP = 1000;
+
+static sockaddr_in loopback(uint16_t port)
+{
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+static double percentile(std::vector<double>& sorted, double p)
+{
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+static void run(const char* name, uint32_t rounds, uint32_t spin_us, bool pinned, uint32_t cpu_a, uint32_t cpu_b)
+{
+    UDPSocket a(PORT_A);
+    UDPSocket b(PORT_B);
+    a.setBusyPoll(spin_us);
+    b.setBusyPoll(spin_us);
+    sockaddr_in addr_b = loopback(PORT_B);
+
+    std::vector<uint32_t> seqs = {1, 2, 3, 4, 5, 6, 7, 8};
+    std::atomic<bool> running(true);
+    std::thread echo([&] {
+        if (pinned) pinCurrentThread(cpu_b);
+        std::vector<uint8_t> data;
+        sockaddr_in from;
+        while (running)
+        {
+            try
+            {
+                b.receive(data, from);
+            }
+            catch (const std::exception&)
+            {
+                break;
+            }
+            Packet packet = Packet::deserialize(data);
+            b.send(from, Packet::createAckPacket(packet.seq_numbers).serialize());
+        }
+    });
+
+    if (pinned) pinCurrentThread(cpu_a);
+    std::vector<double> hops;
+    hops.reserve(rounds);
+    std::vector<uint8_t> reply;
+    sockaddr_in from;
+    for (uint32_t i = 0; i < WARMUP + rounds; i++)
+    {
+        seqs[0] = i + 1;
+        auto start = std::chrono::steady_clock::now();
+        a.send(addr_b, Packet::createDataPacket(1, seqs).serialize());
+        a.receive(reply, from);
+        Packet ack = Packet::deserialize(reply);
+        auto end = std::chrono::steady_clock::now();
+        if (ack.seq_numbers.empty() || ack.seq_numbers[0] != i + 1)
+        {
+            fprintf(stderr, "%s: bad reply in round %u\n", name, i);
+            break;
+        }
+        if (i >= WARMUP) hops.push_back(std::chrono::duration<double, std::micro>(end - start).count() / 2);
+    }
+
+    running = false;
+    b.close();
+    echo.join();
+    if (hops.empty()) return;
+
+    std::sort(hops.begin(), hops.end());
+    printf("%-12s %8zu %9.2f %9.2f %9.2f\n", name, hops.size(), percentile(hops, 0.5), percentile(hops, 0.99),
+           percentile(hops, 0.999));
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t rounds = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 20000;
+    uint32_t spin_us = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 50;
+    uint32_t cpu_a = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 0;
+    uint32_t cpu_b = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 1;
+    std::cout.setstate(std::ios::failbit);  // UDPSocket's [DEBUG] chatter
+
+    printf("rounds=%u spin_us=%u cpus=%u,%u hardware_concurrency=%u\n", rounds, spin_us, cpu_a, cpu_b,
+           std::thread::hardware_concurrency());
+    printf("%-12s %8s %9s %9s %9s\n", "mode", "hops", "p50_us", "p99_us", "p999_us");
+    run("blocking", rounds, 0, false, cpu_a, cpu_b);
+    run("busy", rounds, spin_us, false, cpu_a, cpu_b);
+    run("busy+pinned", rounds, spin_us, true, cpu_a, cpu_b);
+    return 0;
+}
@@ -0,0 +1,64 @@
+// bench_metrics.cpp - per-event cost of metrics::add / addPeer / record
+// Compile: g++ -O2 -std=c++17 -pthread -I../../src/include bench_metrics.cpp ../../src/src/common/metrics.cpp ../../src/src/common/threads.cpp -o bench_metrics
+// Run: ./bench_metrics
+//
+// Single thread first, then THREADS threads hammering the same counter (each has its own
+// slab, so this should scale flat). Also checks that a dump sums every thread's slab.
+
+#include "common/metrics.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint64_t EVENTS = 50000000;
+static constexpr int THREADS = 4;
+
+template <typename F>
+static double ns_per_event(F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < EVENTS; i++) f(i);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+           static_cast<double>(EVENTS);
+}
+
+int main()
+{
+    printf("add        %6.2f ns\n", ns_per_event([](uint64_t) { metrics::add(metrics::Counter::DELIVERIES); }));
+    printf("addPeer    %6.2f ns\n", ns_per_event([](uint64_t i) {
+        metrics::addPeer(metrics::PeerCounter::PACKETS_SENT, static_cast<uint32_t>(i & 7));
+    }));
+    printf("record     %6.2f ns\n", ns_per_event([](uint64_t i) {
+        metrics::record(metrics::Histogram::ACK_RTT_US, (i * 2654435761u) & 0xFFFFF);
+    }));
+
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < THREADS; t++)
+    {
+        threads.emplace_back([] {
+            for (uint64_t i = 0; i < EVENTS; i++) metrics::add(metrics::Counter::DELIVERIES);
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    printf("add x%d    %6.2f ns per event per thread (wall / EVENTS)\n", THREADS,
+           static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+               static_cast<double>(EVENTS));
+
+    metrics::dump("bench_metrics.out");
+    std::ifstream in("bench_metrics.out");
+    std::string name;
+    uint64_t value = 0;
+    while (in >> name >> value && name != "deliveries") {}
+    std::remove("bench_metrics.out");
+    uint64_t expected = EVENTS * (THREADS + 1);
+    printf("deliveries %llu (expected %llu) %s\n", static_cast<unsigned long long>(value),
+           static_cast<unsigned long long>(expected), value == expected ? "OK" : "MISMATCH");
+    return value == expected ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+// bench_simnet.cpp - perfect links and FIFO broadcast over the in-process simulated network
+// Compile: g++ -O2 -std=c++17 -pthread -I../../src/include bench_simnet.cpp ../../src/src/common/*.cpp ../../src/src/network/*.cpp ../../src/src/perfectlink/*.cpp ../../src/src/fifobroadcast/*.cpp -o bench_simnet
+// Run: ./bench_simnet [m] [n] [seed] [profile,...]      (defaults: 2000 4 1 ideal,lan,lossy)
+//
+// For every profile (network/sim_network.hpp) it runs n apps in this process, on SimSockets:
+//   pl:   processes 2..n each send m messages to process 1, done when every Sender is acked
+//   fifo: every process broadcasts m, done when every process FIFO-delivered all n*m
+// and reports delivered messages/s, retransmitted / first transmissions, and latency:
+// ACK RTT (pl) or broadcast->FIFO-deliver of every 10th seq (fifo), from a metrics dump.
+// No root, no tc, no ports; outputs go to a temporary directory.
+
+#include "common/metrics.hpp"
+#include "network/sim_network.hpp"
+#include "perfectlink/perfect_link_app.hpp"
+#include "fifobroadcast/fifo_broadcast_app.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+static constexpr uint16_t BASE_PORT = 12000;
+static constexpr int TIMEOUT_S = 120;
+
+struct Result
+{
+    double seconds = 0.0;
+    uint64_t deliveries = 0;
+    bool complete = false;
+};
+
+// "name value" counters and "hist name count=.. p50=.." lines of a metrics dump
+static std::map<std::string, std::string> read_metrics(const std::string& path)
+{
+    std::map<std::string, std::string> lines;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream words(line);
+        std::string first, name;
+        words >> first;
+        if (first == "hist")
+        {
+            words >> name;
+            lines[name] = line;
+        }
+        else
+        {
+            std::string value;
+            words >> value;
+            lines[first] = value;
+        }
+    }
+    return lines;
+}
+
+static std::string field(const std::string& hist_line, const std::string& key)
+{
+    size_t pos = hist_line.find(" " + key + "=");
+    if (pos == std::string::npos) return "-";
+    pos += key.size() + 2;
+    return hist_line.substr(pos, hist_line.find(' ', pos) - pos);
+}
+
+static uint64_t counter(const std::map<std::string, std::string>& dump, const std::string& name)
+{
+    auto it = dump.find(name);
+    return it == dump.end() ? 0 : std::strtoull(it->second.c_str(), nullptr, 10);
+}
+
+// Counts "d " lines appended since the last call.
+class DeliveryCounter
+{
+public:
+    explicit DeliveryCounter(std::string path) : path_(std::move(path)), offset_(0), count_(0) {}
+
+    uint64_t poll()
+    {
+        std::ifstream in(path_);
+        if (!in.is_open()) return count_;
+        in.seekg(static_cast<std::streamoff>(offset_));
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (in.eof()) break;  // partial last line, reread next time
+            offset_ += line.size() + 1;
+            if (line.size() > 1 && line[0] == 'd' && line[1] == ' ') count_++;
+        }
+        return count_;
+    }
+
+private:
+    std::string path_;
+    size_t offset_;
+    uint64_t count_;
+};
+
+static std::vector<Host> make_hosts(uint32_t n)
+{
+    std::vector<Host> hosts;
+    for (uint32_t i = 1; i <= n; i++)
+    {
+        hosts.emplace_back(i, "127.0.0.1", static_cast<uint16_t>(BASE_PORT + i));
+    }
+    return hosts;
+}
+
+static Result run_pl(SimNetwork& network, const std::string& dir, uint32_t n, uint32_t m)
+{
+    std::vector<Host> hosts = make_hosts(n);
+    std::vector<std::unique_ptr<milestone1::PerfectLinkApp>> apps;
+    for (const Host& host : hosts)
+    {
+        std::string output = dir + "/pl" + std::to_string(host.id) + ".output";
+        std::remove(output.c_str());
+        apps.emplace_back(new milestone1::PerfectLinkApp(host.id, hosts, m, 1, output, RuntimeOptions(),
+                                                         network.attach(host.ip, host.port)));
+    }
+
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> runners;
+    for (auto& app : apps)
+    {
+        runners.emplace_back([&app] { app->run(); });  // Senders return once everything is acked
+    }
+    for (std::thread& runner : runners) runner.join();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& app : apps) app->shutdown();
+    result.deliveries = DeliveryCounter(dir + "/pl1.output").poll();
+    result.complete = result.deliveries == static_cast<uint64_t>(n - 1) * m;
+    return result;
+}
+
+static Result run_fifo(SimNetwork& network, const std::string& dir, uint32_t n, uint32_t m)
+{
+    std::vector<Host> hosts = make_hosts(n);
+    RuntimeOptions options = RuntimeOptions::fromEnv();  // DA_RELAY / DA_REPAIR apply
+    options.trace_sample = 10;
+    std::vector<std::unique_ptr<milestone2::FIFOBroadcastApp>> apps;
+    std::vector<DeliveryCounter> counters;
+    for (const Host& host : hosts)
+    {
+        std::string output = dir + "/fifo" + std::to_string(host.id) + ".output";
+        std::remove(output.c_str());
+        apps.emplace_back(new milestone2::FIFOBroadcastApp(host.id, hosts, m, output, options,
+                                                           network.attach(host.ip, host.port)));
+        counters.emplace_back(output);
+    }
+
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& app : apps) app->run();
+    // The Loggers write in ~4 KiB chunks, so progress comes from the deliveries counter
+    // (every app's logDelivery, zeroed before each run); the files are counted after shutdown.
+    uint64_t target = static_cast<uint64_t>(n) * n * m;
+    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(TIMEOUT_S))
+    {
+        if (metrics::total(metrics::Counter::DELIVERIES) >= target)
+        {
+            result.complete = true;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& app : apps) app->shutdown();
+    for (DeliveryCounter& counter : counters) result.deliveries += counter.poll();
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t m = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 2000;
+    uint32_t n = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 4;
+    uint64_t seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+    std::string profiles = argc > 4 ? argv[4] : "ideal,lan,lossy";
+
+    char dir_template[] = "/tmp/bench_simnet.XXXXXX";
+    if (mkdtemp(dir_template) == nullptr)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string dir = dir_template;
+    std::string metrics_path = dir + "/metrics";
+    std::cout.setstate(std::ios::failbit);  // the apps' [DEBUG] chatter; the table uses printf
+
+    printf("m=%u n=%u seed=%lu\n", m, n, static_cast<unsigned long>(seed));
+    printf("%-7s %-5s %8s %12s %9s %9s %8s %8s %10s %10s\n", "profile", "proto", "secs", "deliv/s",
+           "retx", "sent", "dropped", "dup", "lat_p50us", "lat_p99us");
+    std::istringstream names(profiles);
+    std::string name;
+    while (std::getline(names, name, ','))
+    {
+        const NetworkProfile* profile = NetworkProfile::byName(name);
+        if (profile == nullptr)
+        {
+            fprintf(stderr, "unknown profile %s\n", name.c_str());
+            continue;
+        }
+        for (const char* proto : {"pl", "fifo"})
+        {
+            metrics::reset();
+            SimNetwork network(*profile, seed);
+            bool fifo = std::string(proto) == "fifo";
+            Result result = fifo ? run_fifo(network, dir, n, m) : run_pl(network, dir, n, m);
+            metrics::dump(metrics_path);
+            auto dump = read_metrics(metrics_path);
+            SimNetwork::Stats stats = network.stats();
+
+            // Every message is transmitted once per link and ACKed once, so ACKs received is
+            // the number of distinct (link, message) pairs; retransmissions are on top of that.
+            double retx = counter(dump, "acks_received") > 0
+                              ? static_cast<double>(counter(dump, "retransmissions")) /
+                                    static_cast<double>(counter(dump, "acks_received"))
+                              : 0.0;
+            std::string hist = fifo ? dump["origin.1.broadcast_to_fifo_us"] : dump["ack_rtt_us"];
+            printf("%-7s %-5s %8.3f %12.0f %9.3f %9lu %8lu %8lu %10s %10s%s\n", name.c_str(), proto,
+                   result.seconds, static_cast<double>(result.deliveries) / result.seconds, retx,
+                   static_cast<unsigned long>(stats.sent), static_cast<unsigned long>(stats.dropped),
+                   static_cast<unsigned long>(stats.duplicated), field(hist, "p50").c_str(),
+                   field(hist, "p99").c_str(), result.complete ? "" : "  INCOMPLETE");
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
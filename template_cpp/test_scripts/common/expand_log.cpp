@@ -0,0 +1,35 @@
+// expand_log.cpp - turn a DA_LOG=ranges delivery log into the text output format
+// Compile: g++ -O2 -std=c++17 -I../../src/include expand_log.cpp ../../src/src/common/logger.cpp ../../src/src/common/metrics.cpp ../../src/src/common/threads.cpp -o expand_log -pthread
+// Run: ./expand_log <output>.ranges [output]      (default output: the path without .ranges)
+//
+// da_proc expands its own log when it shuts down; this is for runs that were SIGKILLed,
+// or to look at a ranges file without touching the output. Lines are appended to the
+// output, as the Logger does.
+
+#include "common/logger.hpp"
+#include <cstdio>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "usage: %s <output>.ranges [output]\n", argv[0]);
+        return 2;
+    }
+    std::string ranges = argv[1];
+    std::string output = argc > 2 ? argv[2] : ranges.substr(0, ranges.rfind(".ranges"));
+    if (output == ranges)
+    {
+        fprintf(stderr, "%s: give the output path for a file not named *.ranges\n", argv[0]);
+        return 2;
+    }
+    int64_t lines = Logger::expandRanges(ranges, output);
+    if (lines < 0)
+    {
+        fprintf(stderr, "%s: cannot read %s or write %s\n", argv[0], ranges.c_str(), output.c_str());
+        return 1;
+    }
+    printf("%lld lines -> %s\n", static_cast<long long>(lines), output.c_str());
+    return 0;
+}
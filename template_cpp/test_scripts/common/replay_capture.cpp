@@ -0,0 +1,90 @@
+// replay_capture.cpp - feed a DA_CAPTURE=on capture through the receive path in-process
+// Compile: g++ -O2 -std=c++17 -pthread -I../../src/include replay_capture.cpp ../../src/src/common/*.cpp ../../src/src/network/*.cpp ../../src/src/perfectlink/*.cpp ../../src/src/fifobroadcast/*.cpp -o replay_capture
+// Run: ./replay_capture pl|fifo proc01.output.capture [repeat]
+//
+// Record: run da_proc as usual with DA_CAPTURE=on; each process writes <output>.capture.
+// Replay: a fresh app is built from the peer list in the capture (same id, same hosts) and
+// every datagram goes through handleDatagram() back to back, without sleeping, so the time
+// is the cost of lookup + decode + dedupe + URB/FIFO logic + logging. Protocol threads are
+// not started; ACKs and relays still go out through the app's socket, so the original
+// processes must be gone (the app binds the captured process's port). Set the same DA_RELAY /
+// DA_REPAIR as the captured run. Deliveries are written to <capture>.replay.
+
+#include "network/packet_capture.hpp"
+#include "perfectlink/perfect_link_app.hpp"
+#include "fifobroadcast/fifo_broadcast_app.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+template <typename App>
+static double replay(App& app, const PacketCapture& capture)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (const CapturedDatagram& datagram : capture.datagrams)
+    {
+        app.handleDatagram(datagram.data, datagram.source);
+    }
+    app.shutdown();  // final logger flush counts: it is part of delivering
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double>(elapsed).count();
+}
+
+static size_t count_lines(const std::string& path)
+{
+    std::ifstream in(path);
+    size_t lines = 0;
+    std::string line;
+    while (std::getline(in, line)) lines++;
+    return lines;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || (std::string(argv[1]) != "pl" && std::string(argv[1]) != "fifo"))
+    {
+        fprintf(stderr, "usage: %s pl|fifo <capture> [repeat]\n", argv[0]);
+        return 2;
+    }
+    std::string kind = argv[1];
+    std::string output = std::string(argv[2]) + ".replay";
+    int repeat = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    PacketCapture capture = PacketCapture::load(argv[2]);
+    size_t bytes = 0;
+    for (const CapturedDatagram& datagram : capture.datagrams) bytes += datagram.data.size();
+    double captured_s = capture.datagrams.empty() ? 0.0 : static_cast<double>(capture.datagrams.back().t_us) / 1e6;
+    printf("capture: process %u, %zu hosts, %zu datagrams, %zu bytes over %.3f s\n", capture.my_id,
+           capture.hosts.size(), capture.datagrams.size(), bytes, captured_s);
+
+    RuntimeOptions options = RuntimeOptions::fromEnv();
+    options.capture_enabled = false;
+    double best = 0.0;
+    for (int r = 0; r < repeat; r++)
+    {
+        std::remove(output.c_str());
+        double seconds;
+        if (kind == "pl")
+        {
+            // receiver mode: our own id as receiver_id, so ACKs in the capture are ignored
+            milestone1::PerfectLinkApp app(capture.my_id, capture.hosts, 0, capture.my_id, output, options);
+            seconds = replay(app, capture);
+        }
+        else
+        {
+            milestone2::FIFOBroadcastApp app(capture.my_id, capture.hosts, 0, output, options);
+            seconds = replay(app, capture);
+        }
+        if (r == 0 || seconds < best) best = seconds;
+        printf("run %d: %.3f s, %.0f datagrams/s, %.2f us/datagram, %zu deliveries\n", r + 1, seconds,
+               static_cast<double>(capture.datagrams.size()) / seconds,
+               seconds * 1e6 / static_cast<double>(capture.datagrams.size()), count_lines(output));
+    }
+    if (best > 0.0 && captured_s > 0.0)
+    {
+        printf("best %.3f s, %.1fx faster than the captured run\n", best, captured_s / best);
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+// bench_value_set.cpp - ValueSet vs std::set<uint32_t> on lattice-agreement-shaped workloads
+// Compile: g++ -O2 -std=c++17 -I../../src/include bench_value_set.cpp ../../src/src/lattice/value_set.cpp -o bench_value_set
+// Run: ./bench_value_set
+//
+// For each (ds, vs) a pool of random proposals (1..vs values out of ds random uint32) is
+// built once. "union" folds GROUP proposals into an accumulator, like a proposer merging
+// NACKs for one shot; "subset" tests an accumulator against the next proposal, like an
+// acceptor deciding between ACK and NACK. Times are ns per operation.
+
+#include "lattice/value_set.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+using milestone3::ValueSet;
+using milestone3::ValueUniverse;
+
+static constexpr size_t POOL = 4096;
+static constexpr size_t GROUP = 8;
+static constexpr size_t ROUNDS = 50;
+
+static std::vector<std::vector<uint32_t>> make_pool(uint32_t ds, uint32_t vs, std::mt19937& rng)
+{
+    std::vector<uint32_t> values(ds);
+    for (uint32_t& value : values) value = rng() & 0x7FFFFFFFu;
+    std::vector<std::vector<uint32_t>> pool(POOL);
+    std::uniform_int_distribution<uint32_t> size_dist(1, vs);
+    for (auto& proposal : pool)
+    {
+        uint32_t size = size_dist(rng);
+        std::sample(values.begin(), values.end(), std::back_inserter(proposal), size, rng);
+        std::shuffle(proposal.begin(), proposal.end(), rng);
+    }
+    return pool;
+}
+
+template <typename F>
+static double ns_per_op(size_t ops, F body)
+{
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+           static_cast<double>(ops);
+}
+
+static void run(uint32_t ds, uint32_t vs)
+{
+    std::mt19937 rng(ds * 31u + vs);
+    auto pool = make_pool(ds, vs, rng);
+
+    std::vector<std::set<uint32_t>> std_sets;
+    for (const auto& proposal : pool) std_sets.emplace_back(proposal.begin(), proposal.end());
+
+    ValueUniverse universe(ds, vs);
+    std::vector<ValueSet> value_sets;
+    for (const auto& proposal : pool) value_sets.push_back(universe.fromValues(proposal));
+
+    size_t ops = ROUNDS * POOL;
+    size_t checksum = 0;
+
+    double std_union = ns_per_op(ops, [&] {
+        for (size_t r = 0; r < ROUNDS; r++)
+        {
+            std::set<uint32_t> acc;
+            for (size_t i = 0; i < POOL; i++)
+            {
+                if (i % GROUP == 0) acc.clear();
+                acc.insert(std_sets[i].begin(), std_sets[i].end());
+                checksum += acc.size();
+            }
+        }
+    });
+    double vs_union = ns_per_op(ops, [&] {
+        for (size_t r = 0; r < ROUNDS; r++)
+        {
+            ValueSet acc = universe.emptySet();
+            for (size_t i = 0; i < POOL; i++)
+            {
+                if (i % GROUP == 0) acc = universe.emptySet();
+                acc.unionWith(value_sets[i]);
+                checksum += acc.size();
+            }
+        }
+    });
+
+    // Accumulated sets (as an acceptor's accepted_ would be) for the subset test
+    std::vector<std::set<uint32_t>> std_acc;
+    std::vector<ValueSet> vs_acc;
+    for (size_t i = 0; i < POOL; i++)
+    {
+        std_acc.push_back(std_sets[i]);
+        vs_acc.push_back(value_sets[i]);
+        for (size_t k = 1; k < GROUP / 2; k++)
+        {
+            std_acc.back().insert(std_sets[(i + k) % POOL].begin(), std_sets[(i + k) % POOL].end());
+            vs_acc.back().unionWith(value_sets[(i + k) % POOL]);
+        }
+    }
+
+    double std_subset = ns_per_op(ops, [&] {
+        for (size_t r = 0; r < ROUNDS; r++)
+        {
+            for (size_t i = 0; i < POOL; i++)
+            {
+                const auto& a = std_acc[i];
+                const auto& b = std_sets[(i + r) % POOL];
+                checksum += std::includes(a.begin(), a.end(), b.begin(), b.end()) ? 1 : 0;
+            }
+        }
+    });
+    double vs_subset = ns_per_op(ops, [&] {
+        for (size_t r = 0; r < ROUNDS; r++)
+        {
+            for (size_t i = 0; i < POOL; i++)
+            {
+                checksum += vs_acc[i].includes(value_sets[(i + r) % POOL]) ? 1 : 0;
+            }
+        }
+    });
+
+    // Both sides must agree on the answers, otherwise the timings are meaningless
+    for (size_t i = 0; i < POOL; i++)
+    {
+        const auto& a = std_acc[i];
+        const auto& b = std_sets[(i + 1) % POOL];
+        bool expected = std::includes(a.begin(), a.end(), b.begin(), b.end());
+        if (vs_acc[i].includes(value_sets[(i + 1) % POOL]) != expected || vs_acc[i].size() != a.size())
+        {
+            std::printf("MISMATCH at ds=%u vs=%u i=%zu\n", ds, vs, i);
+            return;
+        }
+    }
+
+    std::printf("%8u %6u %7s %11.1f %11.1f %7.1fx %11.1f %11.1f %7.1fx  (%zu)\n", ds, vs,
+                universe.kind() == ValueSet::Kind::DENSE ? "dense" : "sparse",
+                std_union, vs_union, std_union / vs_union,
+                std_subset, vs_subset, std_subset / vs_subset, checksum % 10);
+}
+
+int main()
+{
+    std::printf("%8s %6s %7s %11s %11s %8s %11s %11s %8s\n", "ds", "vs", "kind",
+                "set union", "vset union", "speedup", "set subset", "vset subset", "speedup");
+    run(5, 3);
+    run(64, 16);
+    run(256, 32);
+    run(1024, 64);
+    run(4096, 256);
+    run(100000, 100);
+    run(100000, 1000);
+    return 0;
+}
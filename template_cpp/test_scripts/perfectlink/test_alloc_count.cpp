@@ -0,0 +1,201 @@
+// test_alloc_count.cpp - malloc calls per message on the perfect-link data path, steady state
+// Compile: g++ -O2 -std=c++17 -pthread -rdynamic -I../../src/include test_alloc_count.cpp ../../src/src/common/*.cpp ../../src/src/network/*.cpp ../../src/src/perfectlink/*.cpp -o test_alloc_count
+// Run: ./test_alloc_count [rounds] [window] [--trace]      (defaults: 200 1000)
+//
+// A Sender (process 2) and a Receiver (process 1) talk over loopback UDP inside this process,
+// with the same receive-side dispatch as PerfectLinkApp::handleDatagram and text Loggers on
+// both ends. The sender enqueues window messages, waits until all are ACKed, and repeats,
+// so the number in flight is bounded and every round looks the same. (PerfectLinkApp::run
+// enqueues all m at once; its in-flight set, and so the pools, grow for as long as the
+// sender outruns the ACKs.) malloc, calloc, realloc and the aligned variants are interposed
+// and counted in every thread from the end of the first 10% of rounds to the start of the
+// last 10%. Expects every message delivered exactly once and fewer than one allocation per
+// 1000 messages in that window: a per-message allocation anywhere shows up as >= 1 per
+// message, while a vector reaching a new high-water mark (the timeout heap holds entries
+// for TIMEOUT after their ACK, so its size follows the send rate) may still double now and
+// then. --trace prints backtraces for the first few allocations in the window.
+
+#include "perfectlink/perfect_link_app.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <execinfo.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* block, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+
+static std::atomic<bool> counting(false);
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<int> traces_left(0);
+static thread_local bool in_trace = false;
+
+static void note_allocation()
+{
+    if (!counting.load(std::memory_order_relaxed)) return;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (in_trace || traces_left.fetch_sub(1, std::memory_order_relaxed) <= 0) return;
+    in_trace = true;  // backtrace() may allocate on its first call
+    void* frames[16];
+    int depth = backtrace(frames, 16);
+    static const char header[] = "--- allocation in the steady-state window:\n";
+    ssize_t ignored = write(2, header, sizeof(header) - 1);
+    (void)ignored;
+    backtrace_symbols_fd(frames, depth, 2);
+    in_trace = false;
+}
+
+extern "C" void* malloc(size_t size)
+{
+    note_allocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    note_allocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* block, size_t size)
+{
+    note_allocation();
+    return __libc_realloc(block, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+    note_allocation();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** block, size_t alignment, size_t size)
+{
+    note_allocation();
+    *block = __libc_memalign(alignment, size);
+    return *block != nullptr ? 0 : ENOMEM;
+}
+
+// Bytes of "d 2 <seq>\n" lines for seq 1..k.
+static uint64_t bytes_through(uint64_t k)
+{
+    uint64_t bytes = 0;
+    uint64_t low = 1;
+    for (uint64_t digits = 1; low <= k; digits++, low *= 10)
+    {
+        uint64_t high = std::min(k, low * 10 - 1);
+        bytes += (high - low + 1) * (4 + digits + 1);
+    }
+    return bytes;
+}
+
+static uint64_t file_size(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+// PerfectLinkApp::receiveLoop + handleDatagram, for either end
+static void receive_loop(UDPSocket& socket, const PeerDirectory& peers, milestone1::Receiver* receiver,
+                         milestone1::Sender* sender)
+{
+    std::vector<uint8_t> data;
+    sockaddr_in source;
+    Packet packet;
+    while (true)
+    {
+        try
+        {
+            socket.receive(data, source);
+        }
+        catch (const std::exception&)
+        {
+            return;
+        }
+        uint32_t peer_index = peers.lookup(source);
+        if (peer_index == PeerDirectory::INVALID_INDEX) continue;
+        Packet::deserializeInto(data, packet);
+        if (packet.type == MessageType::PERFECT_LINK_DATA && receiver != nullptr) receiver->handle(packet, peer_index);
+        if (packet.type == MessageType::PERFECT_LINK_ACK && sender != nullptr) sender->handleAck(packet);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t rounds = 200;
+    uint32_t window = 1000;
+    bool trace = false;
+    std::vector<uint32_t> numbers;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--trace") == 0) trace = true;
+        else numbers.push_back(static_cast<uint32_t>(std::atoi(argv[i])));
+    }
+    if (numbers.size() > 0) rounds = numbers[0];
+    if (numbers.size() > 1) window = numbers[1];
+
+    char dir_template[] = "/tmp/test_alloc_count.XXXXXX";
+    if (mkdtemp(dir_template) == nullptr)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string dir = dir_template;
+
+    PeerDirectory peers({Host(1, "127.0.0.1", 11901), Host(2, "127.0.0.1", 11902)});
+    UDPSocket receiver_socket(11901);
+    UDPSocket sender_socket(11902);
+    Logger receiver_log(dir + "/proc01.output");
+    Logger sender_log(dir + "/proc02.output");
+    milestone1::Receiver receiver(&receiver_socket, peers, &receiver_log);
+    milestone1::Sender sender(&sender_socket, 2, peers.at(0), &sender_log);
+    std::thread receiver_thread(receive_loop, std::ref(receiver_socket), std::cref(peers), &receiver, nullptr);
+    std::thread ack_thread(receive_loop, std::ref(sender_socket), std::cref(peers), nullptr, &sender);
+    receiver.start();
+    sender.start();
+
+    uint32_t first_counted = rounds / 10;
+    uint32_t last_counted = rounds - rounds / 10;
+    uint32_t seq = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++)
+    {
+        if (round == first_counted)
+        {
+            traces_left = trace ? 5 : 0;
+            counting = true;
+        }
+        if (round == last_counted) counting = false;
+        for (uint32_t i = 0; i < window; i++) sender.send(2, ++seq);
+        sender.waitUntilAllAcked();
+    }
+    counting = false;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    sender.stop();
+    receiver.stop();
+    receiver_socket.close();
+    sender_socket.close();
+    receiver_thread.join();
+    ack_thread.join();
+    receiver_log.close();
+
+    uint64_t counted = allocations.load();
+    uint64_t messages = static_cast<uint64_t>(last_counted - first_counted) * window;
+    bool delivered = file_size(dir + "/proc01.output") == bytes_through(seq);
+    printf("%u rounds of %u in %.2fs; %lu messages counted: %lu allocations (%.4f per message)\n", rounds,
+           window, seconds, static_cast<unsigned long>(messages), static_cast<unsigned long>(counted),
+           static_cast<double>(counted) / static_cast<double>(messages));
+    bool steady = counted * 1000 < messages;
+    if (!delivered) printf("FAIL: receiver output is not exactly seqs 1..%u\n", seq);
+    else if (!steady) printf("FAIL: the steady state allocates\n");
+    else printf("PASS\n");
+    return delivered && steady ? 0 : 1;
+}
@@ -6,6 +6,7 @@
 #include "../src/include/common/config.hpp"
 #include "../src/include/common/logger.hpp"
 #include "../src/include/common/signal_handler.hpp"
+#include "../src/include/common/proposal_file.hpp"
 #include <iostream>
 #include <fstream>
 #include <cassert>
@@ -54,9 +55,13 @@ void test_config()
         assert(config.getLatticeAgreementConfig().proposals == 10);
         assert(config.getLatticeAgreementConfig().max_values == 3);
         assert(config.getLatticeAgreementConfig().distinct_values == 5);
-        assert(config.getLatticeAgreementConfig().proposal_sets.size() == 2);
-        assert(config.getLatticeAgreementConfig().proposal_sets[0].size() == 2);
-        assert(config.getLatticeAgreementConfig().proposal_sets[1].size() == 3);
+        
+        ProposalFile proposals(config.getLatticeAgreementConfig().path);
+        ProposalIterator it(proposals);
+        std::vector<uint32_t> values;
+        assert(it.next(values) && values == std::vector<uint32_t>({1, 2}));
+        assert(it.next(values) && values == std::vector<uint32_t>({3, 4, 5}));
+        assert(!it.next(values));
         std::cout << "  ✓ Lattice Agreement config\n";
     }
 }
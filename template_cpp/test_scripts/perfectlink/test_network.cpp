@@ -1,14 +1,21 @@
 // test_network.cpp - Test network layer (UDP socket + Message serialization)
-// Compile: g++ -std=c++17 -I../include test_network.cpp ../common/*.cpp ../network/*.cpp -o test_network
+// Compile: g++ -std=c++17 -pthread -I../include test_network.cpp ../common/*.cpp ../network/*.cpp ../perfectlink/*.cpp -o test_network
 // 
-// Test 1: Message serialization/deserialization
+// Test 1: Message serialization/deserialization, and the Sender's grouping of many small payloads
 // Test 2: UDP communication between two processes
+// Test 3: segmented sends (UDP GSO) and coalesced receives (UDP GRO) over loopback
 
 #include "../include/common/types.hpp"
 #include "../include/network/udp_socket.hpp"
 #include "../include/network/message.hpp"
+#include "../include/perfectlink/perfect_link_app.hpp"
 #include <iostream>
 #include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
 #include <chrono>
 
@@ -62,6 +69,139 @@ void test_message_serialization() {
         
         std::cout << "✓ ACK packet serialization/deserialization\n\n";
     }
+    
+    // Test BROADCAST_PAYLOAD packet: shared bodies, gathered without copying
+    {
+        SharedPayload body = std::make_shared<const std::vector<uint8_t>>(300, 0xAB);
+        OutgoingPacket out;
+        out.packet.type = MessageType::BROADCAST_PAYLOAD;
+        out.packet.sender_id = 7;
+        out.packet.seq_numbers = {41, 42};
+        out.packet.payloads = {body, body};
+        out.packet.acks = {Message(3, 9)};
+        
+        std::vector<uint8_t> bytes = out.packet.serialize();
+        std::cout << "BROADCAST_PAYLOAD packet size: " << bytes.size() << " bytes\n";
+        std::cout << "Expected: 1 + 4 + 1 + 16 (2*(seq+len)) + 1 + 8 (1 ack) + 1 (stamps) + 600 = 632 bytes\n";
+        assert(bytes.size() == 632);
+        
+        const std::vector<iovec>& parts = out.gather();
+        assert(parts.size() == 3);
+        assert(parts[1].iov_base == body->data());
+        std::vector<uint8_t> joined;
+        for (const iovec& part : parts) {
+            const uint8_t* begin = static_cast<const uint8_t*>(part.iov_base);
+            joined.insert(joined.end(), begin, begin + part.iov_len);
+        }
+        assert(joined == bytes);
+        
+        Packet decoded = Packet::deserialize(bytes);
+        assert(decoded.type == MessageType::BROADCAST_PAYLOAD);
+        assert(decoded.sender_id == 7);
+        assert(decoded.seq_numbers.size() == 2 && decoded.seq_numbers[1] == 42);
+        assert(decoded.payloads.size() == 2 && *decoded.payloads[1] == *body);
+        assert(decoded.acks.size() == 1 && decoded.acks[0].seq_number == 9);
+        
+        std::cout << "✓ BROADCAST_PAYLOAD packet serialization/deserialization\n\n";
+    }
+    
+    // A full payload packet: Packet::MAX_ENTRIES small bodies, the most the u8 count can say
+    {
+        Packet original;
+        original.type = MessageType::BROADCAST_PAYLOAD;
+        original.sender_id = 5;
+        for (uint32_t seq = 1; seq <= Packet::MAX_ENTRIES; seq++) {
+            original.seq_numbers.push_back(seq);
+            original.payloads.push_back(std::make_shared<const std::vector<uint8_t>>(8, static_cast<uint8_t>(seq)));
+        }
+        
+        Packet decoded = Packet::deserialize(original.serialize());
+        assert(decoded.seq_numbers == original.seq_numbers);
+        assert(decoded.payloads.size() == Packet::MAX_ENTRIES);
+        for (size_t i = 0; i < decoded.payloads.size(); i++) {
+            assert(*decoded.payloads[i] == *original.payloads[i]);
+        }
+        assert(decoded.acks.empty() && decoded.stamps.empty());
+        
+        std::cout << "✓ BROADCAST_PAYLOAD packet with " << Packet::MAX_ENTRIES << " payloads\n\n";
+    }
+}
+
+// Records every datagram a Sender sends; receive() just waits for close().
+class CaptureTransport : public Transport {
+public:
+    std::mutex mtx;
+    std::condition_variable sent_cv;
+    std::vector<std::vector<uint8_t>> datagrams;
+    
+    void send(const sockaddr_in&, const std::vector<uint8_t>& data) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        datagrams.push_back(data);
+        sent_cv.notify_all();
+    }
+    size_t receive(std::vector<uint8_t>&, sockaddr_in&) override {
+        std::unique_lock<std::mutex> lock(mtx);
+        sent_cv.wait(lock, [this] { return closed_; });
+        throw std::runtime_error("closed");
+    }
+    void close() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed_ = true;
+        sent_cv.notify_all();
+    }
+    
+private:
+    bool closed_ = false;
+};
+
+// 300 eight-byte bodies queued before start() land in one sendLoop batch, far below
+// MAX_PAYLOAD_PACKET_BYTES: the Sender must still split them at Packet::MAX_ENTRIES so
+// every seq and body decodes on the other side.
+void test_payload_grouping() {
+    std::cout << "=== Test 1b: Sender groups many small payloads ===\n";
+    const uint32_t count = 300;
+    CaptureTransport transport;
+    Peer receiver;
+    receiver.id = 2;
+    receiver.index = 1;
+    std::memset(&receiver.addr, 0, sizeof(receiver.addr));
+    milestone1::Sender sender(&transport, 1, receiver, nullptr);
+    for (uint32_t seq = 1; seq <= count; seq++) {
+        std::vector<uint8_t> body(8, static_cast<uint8_t>(seq));
+        sender.send(1, seq, std::make_shared<const std::vector<uint8_t>>(std::move(body)));
+    }
+    sender.start();
+    
+    std::map<uint32_t, std::vector<uint8_t>> received;
+    size_t packets = 0;
+    {
+        std::unique_lock<std::mutex> lock(transport.mtx);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        size_t next = 0;
+        while (received.size() < count) {
+            if (!transport.sent_cv.wait_until(lock, deadline, [&] { return next < transport.datagrams.size(); })) break;
+            for (; next < transport.datagrams.size(); next++) {
+                Packet packet = Packet::deserialize(transport.datagrams[next]);
+                assert(packet.type == MessageType::PERFECT_LINK_PAYLOAD);
+                assert(packet.sender_id == 1);
+                assert(packet.seq_numbers.size() <= Packet::MAX_ENTRIES);
+                assert(packet.payloads.size() == packet.seq_numbers.size());
+                for (size_t i = 0; i < packet.seq_numbers.size(); i++) {
+                    received[packet.seq_numbers[i]] = *packet.payloads[i];
+                }
+                packets++;
+            }
+        }
+    }
+    sender.stop();
+    transport.close();
+    
+    assert(received.size() == count);
+    for (const auto& [seq, body] : received) {
+        assert(seq >= 1 && seq <= count);
+        assert(body == std::vector<uint8_t>(8, static_cast<uint8_t>(seq)));
+    }
+    std::cout << "✓ " << count << " seqs and bodies decoded from " << packets << " packets\n\n";
 }
 
 void test_udp_echo_server() {
@@ -137,11 +277,45 @@ void test_udp_client() {
     std::cout << "Client finished. All packets acknowledged!\n";
 }
 
+// 10 datagrams of 100 bytes and a shorter last one in one sendSegmented call must come out
+// of receive() as the same 11 datagrams, with offload on (GSO + GRO where the kernel has
+// them) and off (one sendto each).
+void test_segmented(bool offload) {
+    std::cout << "=== Test 3: Segmented send, offload " << (offload ? "on" : "off") << " ===\n";
+    UDPSocket sender(12002);
+    UDPSocket receiver(12003);
+    sender.setSegmentationOffload(offload);
+    receiver.setSegmentationOffload(offload);
+    
+    const size_t segment = 100;
+    std::vector<uint8_t> burst;
+    for (uint8_t i = 0; i < 10; i++) burst.insert(burst.end(), segment, i);
+    burst.insert(burst.end(), 37, 10);
+    
+    sockaddr_in dest;
+    std::memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(12003);
+    dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sender.sendSegmented(dest, burst.data(), burst.size(), segment);
+    
+    std::vector<uint8_t> data;
+    sockaddr_in source;
+    for (uint8_t i = 0; i <= 10; i++) {
+        receiver.receive(data, source);
+        assert(data.size() == (i < 10 ? segment : 37));
+        assert(data.front() == i && data.back() == i);
+        assert(ntohs(source.sin_port) == 12002);
+    }
+    std::cout << "✓ 11 datagrams received intact\n\n";
+}
+
 void print_usage() {
     std::cout << "Usage:\n";
     std::cout << "  ./test_network serialize    - Test message serialization only\n";
     std::cout << "  ./test_network server        - Run UDP echo server\n";
     std::cout << "  ./test_network client        - Run UDP client\n";
+    std::cout << "  ./test_network segments      - Test segmented send / coalesced receive on loopback\n";
     std::cout << "\nFor UDP test, run server in one terminal and client in another.\n";
 }
 
@@ -156,11 +330,16 @@ int main(int argc, char** argv) {
     try {
         if (mode == "serialize") {
             test_message_serialization();
+            test_payload_grouping();
             std::cout << "=== All Serialization Tests Passed ✓ ===\n";
         } else if (mode == "server") {
             test_udp_echo_server();
         } else if (mode == "client") {
             test_udp_client();
+        } else if (mode == "segments") {
+            test_segmented(true);
+            test_segmented(false);
+            std::cout << "=== All Segmentation Tests Passed ✓ ===\n";
         } else {
             print_usage();
             return 1;
@@ -0,0 +1,569 @@
+// da_validate: checks the output files of a perfect-links or FIFO broadcast run.
+//
+//   cmake --build <build dir> --target da_validate
+//   <build dir>/validate/da_validate perfect|fifo <logs dir> [--crashed 3,5] [--threads k]
+//                                    [--processes n] [--messages m] [--receiver r]
+//
+// Reads every proc<i>.output in <logs dir> (stress.py's proc01.output works as well); n, m
+// and the perfect-links receiver come from <logs dir>/hosts and <logs dir>/config unless
+// given. Files are mmap'ed and scanned in parallel, one per worker, with a bitmap per origin;
+// the cross-process checks run afterwards on the per-origin summaries:
+//   perfect: no duplication, no creation, validity (every message of a correct sender
+//            delivered by a correct receiver)
+//   fifo:    no duplication, no creation, FIFO order, validity (a correct process delivers
+//            all m of every correct origin, its own included) and uniform agreement (no
+//            process, crashed or not, delivers a message that some correct one doesn't)
+// Processes given with --crashed were killed during the run; their files may be missing
+// or cut short. Exit status 0 when every check passes, 1 on any violation, 2 on bad usage.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr size_t MAX_REPORTED_ERRORS = 10;  // per file; the rest are only counted
+
+enum class Mode
+{
+    PERFECT,
+    FIFO
+};
+
+struct Options
+{
+    Mode mode = Mode::FIFO;
+    std::string dir;
+    uint32_t processes = 0;
+    uint64_t messages = 0;
+    uint32_t receiver = 0;
+    std::set<uint32_t> crashed;
+    unsigned threads = 0;
+};
+
+struct OutputFile
+{
+    uint32_t id = 0;
+    std::string path;
+};
+
+// What one output file says, per origin (index origin - 1)
+struct FileScan
+{
+    bool present = false;
+    uint64_t lines = 0;
+    uint64_t broadcasts = 0;
+    uint64_t last_broadcast = 0;
+    std::vector<uint64_t> delivered;  // distinct deliveries
+    std::vector<uint64_t> last;       // fifo: last seq delivered, for the order check
+    std::vector<uint64_t> max_seq;
+    uint64_t errors = 0;
+    std::vector<std::string> messages;
+
+    void error(const std::string& message)
+    {
+        if (errors++ < MAX_REPORTED_ERRORS) messages.push_back(message);
+    }
+};
+
+// ======================
+// Scanner
+// ======================
+
+// Digits at p, SWAR 8 bytes at a time where 8 bytes are readable: flag the non-digit bytes
+// with carry-free byte arithmetic, then fold the digit bytes pairwise (10, 100, 10000) into
+// the value. Returns the first byte after the number, or nullptr if there is none.
+static const char* scan_uint(const char* p, const char* end, uint64_t& value)
+{
+    const char* start = p;
+    value = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (end - p >= 8)
+    {
+        uint64_t chunk;
+        std::memcpy(&chunk, p, sizeof(chunk));
+        uint64_t low7 = chunk & 0x7F7F7F7F7F7F7F7FULL;
+        uint64_t below = ~(low7 + 0x5050505050505050ULL);  // high bit set: byte < '0'
+        uint64_t above = low7 + 0x4646464646464646ULL;      // high bit set: byte > '9'
+        uint64_t non_digit = (chunk | below | above) & 0x8080808080808080ULL;
+        unsigned digits = non_digit == 0 ? 8 : static_cast<unsigned>(__builtin_ctzll(non_digit)) / 8;
+        if (digits == 0) break;
+
+        // the digits end up in the high bytes, as the last (least significant) ones
+        uint64_t x = (chunk - 0x3030303030303030ULL) << (8 * (8 - digits));
+        x = (x * 10 + (x >> 8)) & 0x00FF00FF00FF00FFULL;
+        x = (x * 100 + (x >> 16)) & 0x0000FFFF0000FFFFULL;
+        x = (x * 10000 + (x >> 32)) & 0x00000000FFFFFFFFULL;
+        uint64_t scale = 1;
+        for (unsigned i = 0; i < digits; i++) scale *= 10;
+        value = value * scale + x;
+        p += digits;
+        if (digits < 8) return p;
+    }
+#endif
+    while (p < end)
+    {
+        unsigned digit = static_cast<unsigned>(static_cast<unsigned char>(*p)) - '0';
+        if (digit > 9) break;
+        value = value * 10 + digit;
+        p++;
+    }
+    return p == start ? nullptr : p;
+}
+
+static const char* next_line(const char* p, const char* end)
+{
+    const void* newline = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    return newline == nullptr ? end : static_cast<const char*>(newline) + 1;
+}
+
+class Bitmap
+{
+public:
+    void reset(uint64_t bits)
+    {
+        words_.assign((bits + 64) / 64, 0);
+    }
+
+    // Sets the bit; true if it was already set
+    bool testAndSet(uint64_t bit)
+    {
+        uint64_t& word = words_[bit / 64];
+        uint64_t mask = 1ULL << (bit % 64);
+        bool was_set = (word & mask) != 0;
+        word |= mask;
+        return was_set;
+    }
+
+private:
+    std::vector<uint64_t> words_;
+};
+
+static void scan_file(const Options& options, const OutputFile& file, FileScan& scan,
+                      std::vector<Bitmap>& bitmaps)
+{
+    uint32_t n = options.processes;
+    uint64_t m = options.messages;
+    scan.delivered.assign(n, 0);
+    scan.last.assign(n, 0);
+    scan.max_seq.assign(n, 0);
+    std::vector<bool> seen(n, false);
+
+    int fd = open(file.path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    scan.present = true;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        scan.error("mmap failed: " + std::string(std::strerror(errno)));
+        return;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const char* p = static_cast<const char*>(mapping);
+    const char* end = p + size;
+    while (p < end)
+    {
+        scan.lines++;
+        const char* line = p;
+        const char* after = nullptr;
+        uint64_t origin = 0, seq = 0;
+        if (end - p > 2 && p[0] == 'b' && p[1] == ' ')
+        {
+            after = scan_uint(p + 2, end, seq);
+            if (after != nullptr && (after == end || *after == '\n'))
+            {
+                if (seq != scan.last_broadcast + 1)
+                {
+                    scan.error("line " + std::to_string(scan.lines) + ": broadcast " + std::to_string(seq) +
+                               " after " + std::to_string(scan.last_broadcast));
+                }
+                scan.broadcasts++;
+                scan.last_broadcast = seq;
+                p = after == end ? end : after + 1;
+                continue;
+            }
+        }
+        else if (end - p > 2 && p[0] == 'd' && p[1] == ' ')
+        {
+            after = scan_uint(p + 2, end, origin);
+            if (after != nullptr && after < end && *after == ' ')
+            {
+                after = scan_uint(after + 1, end, seq);
+            }
+            else
+            {
+                after = nullptr;
+            }
+            if (after != nullptr && (after == end || *after == '\n'))
+            {
+                p = after == end ? end : after + 1;
+                if (origin < 1 || origin > n || seq < 1 || seq > m)
+                {
+                    scan.error("line " + std::to_string(scan.lines) + ": d " + std::to_string(origin) + " " +
+                               std::to_string(seq) + " is out of range (n=" + std::to_string(n) +
+                               ", m=" + std::to_string(m) + ")");
+                    continue;
+                }
+                size_t o = origin - 1;
+                if (!seen[o])
+                {
+                    bitmaps[o].reset(m);
+                    seen[o] = true;
+                }
+                if (bitmaps[o].testAndSet(seq))
+                {
+                    scan.error("line " + std::to_string(scan.lines) + ": duplicate delivery of " +
+                               std::to_string(origin) + " " + std::to_string(seq));
+                    continue;
+                }
+                scan.delivered[o]++;
+                scan.max_seq[o] = std::max(scan.max_seq[o], seq);
+                if (options.mode == Mode::FIFO && seq != scan.last[o] + 1)
+                {
+                    scan.error("line " + std::to_string(scan.lines) + ": FIFO violation, " +
+                               std::to_string(origin) + " " + std::to_string(seq) + " delivered after " +
+                               std::to_string(scan.last[o]));
+                }
+                scan.last[o] = seq;
+                continue;
+            }
+        }
+        p = next_line(line, end);
+        scan.error("line " + std::to_string(scan.lines) + ": malformed \"" +
+                   std::string(line, static_cast<size_t>(std::min<std::ptrdiff_t>(p - line, 40))) + "\"");
+    }
+    munmap(mapping, size);
+}
+
+// ======================
+// Cross-process checks
+// ======================
+
+static uint64_t check_perfect(const Options& options, const std::vector<FileScan>& scans,
+                              std::vector<std::string>& report)
+{
+    uint64_t violations = 0;
+    uint32_t r = options.receiver;
+    auto correct = [&options](uint32_t id) { return options.crashed.count(id) == 0; };
+    for (uint32_t id = 1; id <= options.processes; id++)
+    {
+        const FileScan& scan = scans[id - 1];
+        if (id == r && scan.broadcasts > 0)
+        {
+            violations++;
+            report.push_back("proc " + std::to_string(id) + ": the receiver logged broadcasts");
+        }
+        if (id != r && std::count_if(scan.delivered.begin(), scan.delivered.end(),
+                                     [](uint64_t d) { return d > 0; }) > 0)
+        {
+            violations++;
+            report.push_back("proc " + std::to_string(id) + ": a sender logged deliveries");
+        }
+        if (id == r || !correct(id)) continue;
+        if (scan.broadcasts != options.messages)
+        {
+            violations++;
+            report.push_back("proc " + std::to_string(id) + ": correct sender sent " +
+                             std::to_string(scan.broadcasts) + " of " + std::to_string(options.messages));
+        }
+        const FileScan& receiver = scans[r - 1];
+        if (receiver.max_seq[id - 1] > scan.broadcasts)
+        {
+            violations++;
+            report.push_back("no creation: receiver delivered " + std::to_string(id) + " " +
+                             std::to_string(receiver.max_seq[id - 1]) + ", sender sent " +
+                             std::to_string(scan.broadcasts));
+        }
+        if (correct(r) && receiver.delivered[id - 1] != scan.broadcasts)
+        {
+            violations++;
+            report.push_back("validity: receiver delivered " + std::to_string(receiver.delivered[id - 1]) +
+                             " of the " + std::to_string(scan.broadcasts) + " sent by " + std::to_string(id));
+        }
+    }
+    return violations;
+}
+
+static uint64_t check_fifo(const Options& options, const std::vector<FileScan>& scans,
+                           std::vector<std::string>& report)
+{
+    uint64_t violations = 0;
+    uint32_t n = options.processes;
+    auto correct = [&options](uint32_t id) { return options.crashed.count(id) == 0; };
+    for (uint32_t o = 1; o <= n; o++)
+    {
+        const FileScan& origin = scans[o - 1];
+        if (correct(o) && origin.broadcasts != options.messages)
+        {
+            violations++;
+            report.push_back("proc " + std::to_string(o) + ": correct process broadcast " +
+                             std::to_string(origin.broadcasts) + " of " + std::to_string(options.messages));
+        }
+        uint64_t min_correct = UINT64_MAX;
+        uint64_t max_any = 0;
+        for (uint32_t p = 1; p <= n; p++)
+        {
+            const FileScan& scan = scans[p - 1];
+            uint64_t delivered = scan.delivered[o - 1];
+            max_any = std::max(max_any, scan.max_seq[o - 1]);
+            if (!correct(p)) continue;
+            min_correct = std::min(min_correct, delivered);
+            if (correct(o) && delivered != origin.broadcasts)
+            {
+                violations++;
+                report.push_back("validity: proc " + std::to_string(p) + " delivered " + std::to_string(delivered) +
+                                 " of the " + std::to_string(origin.broadcasts) + " broadcast by " +
+                                 std::to_string(o));
+            }
+        }
+        if (correct(o) && max_any > origin.broadcasts)
+        {
+            violations++;
+            report.push_back("no creation: " + std::to_string(o) + " " + std::to_string(max_any) +
+                             " delivered, only " + std::to_string(origin.broadcasts) + " broadcast");
+        }
+        if (min_correct != UINT64_MAX && max_any > min_correct)
+        {
+            violations++;
+            report.push_back("agreement: some process delivered " + std::to_string(o) + " " +
+                             std::to_string(max_any) + ", a correct one stopped at " + std::to_string(min_correct));
+        }
+    }
+    return violations;
+}
+
+// ======================
+// Setup
+// ======================
+
+static std::vector<OutputFile> list_outputs(const std::string& dir)
+{
+    std::vector<OutputFile> files;
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr) return files;
+    while (dirent* entry = readdir(handle))
+    {
+        std::string name = entry->d_name;
+        const std::string suffix = ".output";
+        if (name.compare(0, 4, "proc") != 0 || name.size() <= 4 + suffix.size() ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+        {
+            continue;
+        }
+        std::string digits = name.substr(4, name.size() - 4 - suffix.size());
+        if (digits.find_first_not_of("0123456789") != std::string::npos) continue;
+        OutputFile file;
+        file.id = static_cast<uint32_t>(std::strtoul(digits.c_str(), nullptr, 10));
+        file.path = dir + "/" + name;
+        files.push_back(file);
+    }
+    closedir(handle);
+    std::sort(files.begin(), files.end(), [](const OutputFile& a, const OutputFile& b) { return a.id < b.id; });
+    return files;
+}
+
+static void read_run_files(Options& options, const std::vector<OutputFile>& files)
+{
+    if (options.processes == 0)
+    {
+        std::ifstream hosts(options.dir + "/hosts");
+        std::string line;
+        while (std::getline(hosts, line))
+        {
+            if (line.find_first_not_of(" \t\r") != std::string::npos) options.processes++;
+        }
+        for (const OutputFile& file : files) options.processes = std::max(options.processes, file.id);
+    }
+    std::ifstream config(options.dir + "/config");
+    uint64_t m = 0;
+    uint32_t receiver = 0;
+    config >> m >> receiver;
+    if (options.messages == 0) options.messages = m;
+    if (options.receiver == 0) options.receiver = receiver;
+}
+
+static bool parse_ids(const std::string& list, std::set<uint32_t>& ids)
+{
+    std::istringstream in(list);
+    std::string id;
+    while (std::getline(in, id, ','))
+    {
+        if (id.empty() || id.find_first_not_of("0123456789") != std::string::npos) return false;
+        ids.insert(static_cast<uint32_t>(std::strtoul(id.c_str(), nullptr, 10)));
+    }
+    return true;
+}
+
+static int usage(const char* argv0)
+{
+    fprintf(stderr,
+            "usage: %s perfect|fifo <logs dir> [--crashed <id,id,..>] [--threads <k>]\n"
+            "       [--processes <n>] [--messages <m>] [--receiver <id>]\n",
+            argv0);
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) return usage(argv[0]);
+    Options options;
+    std::string mode = argv[1];
+    if (mode == "perfect")
+    {
+        options.mode = Mode::PERFECT;
+    }
+    else if (mode != "fifo")
+    {
+        return usage(argv[0]);
+    }
+    options.dir = argv[2];
+    for (int i = 3; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return usage(argv[0]);
+        std::string value = argv[++i];
+        if (arg == "--crashed")
+        {
+            if (!parse_ids(value, options.crashed)) return usage(argv[0]);
+        }
+        else if (arg == "--threads")
+        {
+            options.threads = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+        }
+        else if (arg == "--processes")
+        {
+            options.processes = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        }
+        else if (arg == "--messages")
+        {
+            options.messages = std::strtoull(value.c_str(), nullptr, 10);
+        }
+        else if (arg == "--receiver")
+        {
+            options.receiver = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        }
+        else
+        {
+            return usage(argv[0]);
+        }
+    }
+
+    std::vector<OutputFile> files = list_outputs(options.dir);
+    read_run_files(options, files);
+    if (options.processes == 0 || options.messages == 0 ||
+        (options.mode == Mode::PERFECT && (options.receiver < 1 || options.receiver > options.processes)))
+    {
+        fprintf(stderr, "%s: cannot tell n, m%s; pass them or put hosts and config in %s\n", argv[0],
+                options.mode == Mode::PERFECT ? " and the receiver" : "", options.dir.c_str());
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<FileScan> scans(options.processes);
+    std::vector<std::string> unexpected;
+    std::vector<const OutputFile*> work;
+    for (const OutputFile& file : files)
+    {
+        if (file.id >= 1 && file.id <= options.processes)
+        {
+            work.push_back(&file);
+        }
+        else
+        {
+            unexpected.push_back(file.path);
+        }
+    }
+    unsigned threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, static_cast<unsigned>(std::max<size_t>(1, work.size())));
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&] {
+            std::vector<Bitmap> bitmaps(options.processes);  // per worker, reused across files
+            for (size_t i = next++; i < work.size(); i = next++)
+            {
+                scan_file(options, *work[i], scans[work[i]->id - 1], bitmaps);
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    // files that were never scanned still need their per-origin vectors
+    for (FileScan& scan : scans)
+    {
+        if (scan.delivered.empty())
+        {
+            scan.delivered.assign(options.processes, 0);
+            scan.last.assign(options.processes, 0);
+            scan.max_seq.assign(options.processes, 0);
+        }
+    }
+
+    std::vector<std::string> report;
+    uint64_t violations = 0;
+    uint64_t lines = 0;
+    for (uint32_t id = 1; id <= options.processes; id++)
+    {
+        const FileScan& scan = scans[id - 1];
+        lines += scan.lines;
+        violations += scan.errors;
+        if (!scan.present && options.crashed.count(id) == 0)
+        {
+            violations++;
+            report.push_back("proc " + std::to_string(id) + ": no output file");
+        }
+    }
+    violations += options.mode == Mode::FIFO ? check_fifo(options, scans, report)
+                                             : check_perfect(options, scans, report);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s n=%u m=%lu: %zu files, %lu lines in %.3f s (%u threads)\n", mode.c_str(), options.processes,
+           static_cast<unsigned long>(options.messages), work.size(), static_cast<unsigned long>(lines), seconds,
+           threads);
+    for (const std::string& path : unexpected) printf("ignored %s (id outside 1..n)\n", path.c_str());
+    for (uint32_t id = 1; id <= options.processes; id++)
+    {
+        const FileScan& scan = scans[id - 1];
+        uint64_t delivered = 0;
+        for (uint64_t d : scan.delivered) delivered += d;
+        printf("proc %u%s: %lu broadcast, %lu delivered%s\n", id, options.crashed.count(id) ? " (crashed)" : "",
+               static_cast<unsigned long>(scan.broadcasts), static_cast<unsigned long>(delivered),
+               scan.present ? "" : ", no output file");
+        for (const std::string& message : scan.messages) printf("  %s\n", message.c_str());
+        if (scan.errors > scan.messages.size())
+        {
+            printf("  ... %lu more\n", static_cast<unsigned long>(scan.errors - scan.messages.size()));
+        }
+    }
+    for (const std::string& line : report) printf("%s\n", line.c_str());
+    if (violations == 0)
+    {
+        printf("PASS\n");
+        return 0;
+    }
+    printf("FAIL: %lu violations\n", static_cast<unsigned long>(violations));
+    return 1;
+}
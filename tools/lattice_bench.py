@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+
+"""Throughput benchmark for multi-shot lattice agreement.
+
+Generates n proposal configs with p shots of up to vs values drawn from ds distinct values
+(same scheme as stress.py), starts n local da_proc instances, waits until every process
+has logged p decisions and reports shots/sec plus bytes per decision (lo tx_bytes from
+/proc/net/dev over n*p; run it on an otherwise idle host). With --check it also verifies
+per shot that each decision contains the process' own proposal, is contained in the union
+of all proposals, and that all decisions are comparable (one is a subset of the other).
+"""
+
+import argparse
+import os
+import random
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+PROCESSES_BASE_PORT = 11000
+
+
+def loopback_tx_bytes():
+    with open("/proc/net/dev") as f:
+        for line in f:
+            name, _, fields = line.partition(":")
+            if name.strip() == "lo":
+                return int(fields.split()[8])
+    return 0
+
+
+def count_lines(path):
+    try:
+        with open(path, "rb") as f:
+            return sum(1 for _ in f)
+    except FileNotFoundError:
+        return 0
+
+
+def read_sets(path, skip_header):
+    with open(path) as f:
+        lines = f.read().splitlines()
+    if skip_header:
+        lines = lines[1:]
+    return [frozenset(int(x) for x in line.split()) for line in lines]
+
+
+def write_configs(workdir, n, p, vs, ds, seed):
+    rand = random.Random(seed)
+    values = rand.sample(range(0, 2**31), ds)
+    configs = []
+    for i in range(1, n + 1):
+        path = os.path.join(workdir, "proc{:02d}.config".format(i))
+        with open(path, "w") as f:
+            f.write("{} {} {}\n".format(p, vs, ds))
+            for _ in range(p):
+                f.write(" ".join(map(str, rand.sample(values, rand.randint(1, vs)))))
+                f.write("\n")
+        configs.append(path)
+    return configs
+
+
+def check(configs, outputs, p):
+    proposals = [read_sets(path, True) for path in configs]
+    decisions = [read_sets(path, False) for path in outputs]
+    errors = 0
+    for shot in range(p):
+        union = frozenset().union(*(props[shot] for props in proposals))
+        decided = [d[shot] for d in decisions if shot < len(d)]
+        for i, d in enumerate(decisions):
+            if shot < len(d) and not (proposals[i][shot] <= d[shot] <= union):
+                errors += 1
+        for a in decided:
+            for b in decided:
+                if not (a <= b or b <= a):
+                    errors += 1
+    return errors
+
+
+def run_once(binary, n, p, vs, ds, pipeline, timeout, workdir, seed, verify):
+    hosts = os.path.join(workdir, "hosts")
+    with open(hosts, "w") as f:
+        for i in range(1, n + 1):
+            f.write("{} 127.0.0.1 {}\n".format(i, PROCESSES_BASE_PORT + i))
+    configs = write_configs(workdir, n, p, vs, ds, seed)
+    outputs = [os.path.join(workdir, "proc{:02d}.output".format(i)) for i in range(1, n + 1)]
+    for path in outputs:
+        if os.path.exists(path):
+            os.remove(path)
+
+    env = dict(os.environ, DA_LA_PIPELINE=str(pipeline))
+    before = loopback_tx_bytes()
+    start = time.time()
+    procs = [
+        subprocess.Popen(
+            [binary, "--id", str(i), "--hosts", hosts, "--output", outputs[i - 1], configs[i - 1]],
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.DEVNULL,
+            env=env,
+        )
+        for i in range(1, n + 1)
+    ]
+
+    done = False
+    try:
+        while time.time() - start < timeout:
+            if all(count_lines(path) >= p for path in outputs):  # the last decision flushes
+                done = True
+                break
+            time.sleep(0.05)
+        elapsed = time.time() - start
+        sent_bytes = loopback_tx_bytes() - before
+    finally:
+        for proc in procs:
+            proc.send_signal(signal.SIGTERM)
+        for proc in procs:
+            try:
+                proc.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+
+    decided = min(count_lines(path) for path in outputs)
+    errors = check(configs, outputs, p) if verify else None
+    return done, elapsed, decided, sent_bytes, errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("-b", "--binary", required=True, help="Path to da_proc")
+    parser.add_argument("-n", "--processes", type=int, default=3, help="Number of processes")
+    parser.add_argument("-p", "--proposals", type=int, default=100000, help="Shots per process")
+    parser.add_argument("--vs", type=int, default=3, help="Max values per proposal")
+    parser.add_argument("--ds", type=int, default=5, help="Distinct values overall")
+    parser.add_argument("--pipeline", default="1,8,32,128",
+                        help="Comma-separated DA_LA_PIPELINE depths")
+    parser.add_argument("--timeout", type=float, default=300.0, help="Seconds per run")
+    parser.add_argument("--seed", type=int, default=42)
+    parser.add_argument("--check", action="store_true", help="Verify validity and consistency")
+    args = parser.parse_args()
+
+    binary = os.path.abspath(args.binary)
+    print("{:>4} {:>8} {:>8} {:>10} {:>8} {:>12} {:>10}{}".format(
+        "n", "p", "depth", "decided", "secs", "shots/s", "B/decision",
+        "  errors" if args.check else ""))
+    with tempfile.TemporaryDirectory(prefix="da_lattice_bench_") as workdir:
+        for depth in [int(x) for x in args.pipeline.split(",")]:
+            done, elapsed, decided, sent_bytes, errors = run_once(
+                binary, args.processes, args.proposals, args.vs, args.ds, depth,
+                args.timeout, workdir, args.seed, args.check)
+            per_decision = sent_bytes / (args.processes * decided) if decided else float("nan")
+            print("{:>4} {:>8} {:>8} {:>10} {:>8.2f} {:>12.0f} {:>10.1f}{}{}".format(
+                args.processes, args.proposals, depth, decided, elapsed, decided / elapsed,
+                per_decision,
+                "  {:>6}".format(errors) if args.check else "",
+                "" if done else "  (timeout)"))
+            sys.stdout.flush()
+            time.sleep(0.5)
+
+
+if __name__ == "__main__":
+    main()
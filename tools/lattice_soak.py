@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+
+"""RSS soak test for long multi-shot lattice agreement runs.
+
+Starts n local da_proc instances on p proposals each (default p = 10^6, configs generated
+as in lattice_bench.py) and samples every --interval seconds how many shots every process
+has decided and the resident set size (VmRSS) of each process. With decided-shot garbage
+collection the RSS column should level off after warm-up instead of growing with p.
+"""
+
+import argparse
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+from lattice_bench import PROCESSES_BASE_PORT, count_lines, write_configs
+
+
+def rss_kb(pid):
+    try:
+        with open("/proc/{}/status".format(pid)) as f:
+            for line in f:
+                if line.startswith("VmRSS:"):
+                    return int(line.split()[1])
+    except FileNotFoundError:
+        pass
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("-b", "--binary", required=True, help="Path to da_proc")
+    parser.add_argument("-n", "--processes", type=int, default=3, help="Number of processes")
+    parser.add_argument("-p", "--proposals", type=int, default=1000000, help="Shots per process")
+    parser.add_argument("--vs", type=int, default=3, help="Max values per proposal")
+    parser.add_argument("--ds", type=int, default=5, help="Distinct values overall")
+    parser.add_argument("--interval", type=float, default=10.0, help="Seconds between samples")
+    parser.add_argument("--timeout", type=float, default=1800.0, help="Give up after this long")
+    parser.add_argument("--seed", type=int, default=42)
+    args = parser.parse_args()
+
+    binary = os.path.abspath(args.binary)
+    n, p = args.processes, args.proposals
+    with tempfile.TemporaryDirectory(prefix="da_lattice_soak_") as workdir:
+        hosts = os.path.join(workdir, "hosts")
+        with open(hosts, "w") as f:
+            for i in range(1, n + 1):
+                f.write("{} 127.0.0.1 {}\n".format(i, PROCESSES_BASE_PORT + i))
+        configs = write_configs(workdir, n, p, args.vs, args.ds, args.seed)
+        outputs = [os.path.join(workdir, "proc{:02d}.output".format(i)) for i in range(1, n + 1)]
+
+        start = time.time()
+        procs = [
+            subprocess.Popen(
+                [binary, "--id", str(i), "--hosts", hosts, "--output", outputs[i - 1], configs[i - 1]],
+                stdout=subprocess.DEVNULL,
+                stderr=subprocess.DEVNULL,
+            )
+            for i in range(1, n + 1)
+        ]
+
+        print("{:>8} {:>10} {}".format(
+            "secs", "decided", " ".join("{:>10}".format("rss{}_KB".format(i)) for i in range(1, n + 1))))
+        try:
+            while True:
+                time.sleep(args.interval)
+                decided = min(count_lines(path) for path in outputs)
+                rss = [rss_kb(proc.pid) for proc in procs]
+                print("{:>8.0f} {:>10} {}".format(
+                    time.time() - start, decided, " ".join("{:>10}".format(kb) for kb in rss)))
+                sys.stdout.flush()
+                if decided >= p or time.time() - start > args.timeout:
+                    break
+        finally:
+            for proc in procs:
+                proc.send_signal(signal.SIGTERM)
+            for proc in procs:
+                try:
+                    proc.wait(timeout=5)
+                except subprocess.TimeoutExpired:
+                    proc.kill()
+
+
+if __name__ == "__main__":
+    main()
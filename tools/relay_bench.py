@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+
+"""Packets-per-delivery benchmark for the FIFO broadcast relay strategies.
+
+For every process count n and relay mode (flood, tree, or tree with DA_REPAIR=digest)
+it starts n local da_proc instances broadcasting m messages each, waits until every process has
+FIFO-delivered all n*m messages, and reports the UDP datagrams sent host-wide
+(OutDatagrams from /proc/net/snmp) divided by the number of deliveries.
+Run it on an otherwise idle host: other UDP traffic is counted too.
+"""
+
+import argparse
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+PROCESSES_BASE_PORT = 11000
+MODES = {
+    "flood": {"DA_RELAY": "flood"},
+    "tree": {"DA_RELAY": "tree"},
+    "digest": {"DA_RELAY": "tree", "DA_REPAIR": "digest"},
+}
+METRICS_INTERVAL_MS = 50  # the text log is written in ~4 KiB chunks; progress comes from the snapshots
+
+
+def udp_out_datagrams():
+    with open("/proc/net/snmp") as f:
+        lines = [line.split() for line in f if line.startswith("Udp:")]
+    header, values = lines[0], lines[1]
+    return int(values[header.index("OutDatagrams")])
+
+
+def count_deliveries(path):
+    try:
+        with open(path, "rb") as f:
+            return sum(1 for line in f if line.startswith(b"d "))
+    except FileNotFoundError:
+        return 0
+
+
+def metrics_deliveries(path):
+    try:
+        with open(path + ".metrics") as f:
+            for line in f:
+                words = line.split()
+                if len(words) == 2 and words[0] == "deliveries":
+                    return int(words[1])
+    except FileNotFoundError:
+        pass
+    return 0
+
+
+def run_once(binary, n, m, mode, fanout, timeout, workdir):
+    hosts = os.path.join(workdir, "hosts")
+    config = os.path.join(workdir, "config")
+    with open(hosts, "w") as f:
+        for i in range(1, n + 1):
+            f.write("{} 127.0.0.1 {}\n".format(i, PROCESSES_BASE_PORT + i))
+    with open(config, "w") as f:
+        f.write("{}\n".format(m))
+
+    env = dict(os.environ, DA_RELAY_FANOUT=str(fanout), DA_METRICS_INTERVAL=str(METRICS_INTERVAL_MS),
+               **MODES[mode])
+    outputs = [os.path.join(workdir, "proc{:02d}.output".format(i)) for i in range(1, n + 1)]
+    for path in outputs:
+        for stale in [path, path + ".metrics"]:
+            if os.path.exists(stale):
+                os.remove(stale)
+
+    before = udp_out_datagrams()
+    start = time.time()
+    procs = [
+        subprocess.Popen(
+            [binary, "--id", str(i), "--hosts", hosts, "--output", outputs[i - 1], config],
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.DEVNULL,
+            env=env,
+        )
+        for i in range(1, n + 1)
+    ]
+
+    expected = n * m
+    done = False
+    try:
+        while time.time() - start < timeout:
+            if all(metrics_deliveries(path) >= expected for path in outputs):
+                done = True
+                break
+            time.sleep(0.05)
+        elapsed = time.time() - start
+        datagrams = udp_out_datagrams() - before
+    finally:
+        for p in procs:
+            p.send_signal(signal.SIGTERM)
+        for p in procs:
+            try:
+                p.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                p.kill()
+
+    deliveries = sum(count_deliveries(path) for path in outputs)
+    return done, elapsed, datagrams, deliveries
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("-b", "--binary", required=True, help="Path to da_proc")
+    parser.add_argument("-n", "--processes", default="3,5,10,20,30",
+                        help="Comma-separated process counts")
+    parser.add_argument("-m", "--messages", type=int, default=100,
+                        help="Messages broadcast by each process")
+    parser.add_argument("--modes", default="flood,tree,digest",
+                        help="Comma-separated relay modes: " + ",".join(MODES))
+    parser.add_argument("--fanout", type=int, default=3, help="DA_RELAY_FANOUT for tree mode")
+    parser.add_argument("--timeout", type=float, default=60.0, help="Seconds per run")
+    args = parser.parse_args()
+
+    binary = os.path.abspath(args.binary)
+    modes = args.modes.split(",")
+    counts = [int(x) for x in args.processes.split(",")]
+
+    print("{:>4} {:>6} {:>12} {:>12} {:>10} {:>10} {:>8}".format(
+        "n", "mode", "datagrams", "deliveries", "pkt/deliv", "pkt/bcast", "secs"))
+    with tempfile.TemporaryDirectory(prefix="da_relay_bench_") as workdir:
+        for n in counts:
+            for mode in modes:
+                done, elapsed, datagrams, deliveries = run_once(
+                    binary, n, args.messages, mode, args.fanout, args.timeout, workdir)
+                per_delivery = datagrams / deliveries if deliveries else float("nan")
+                per_broadcast = datagrams / (n * args.messages)
+                print("{:>4} {:>6} {:>12} {:>12} {:>10.3f} {:>10.1f} {:>8.2f}{}".format(
+                    n, mode, datagrams, deliveries, per_delivery, per_broadcast, elapsed,
+                    "" if done else "  (timeout)"))
+                sys.stdout.flush()
+                time.sleep(0.5)
+
+
+if __name__ == "__main__":
+    main()
@@ -6,6 +6,7 @@ import textwrap
 import time
 import threading, subprocess
 import itertools
+import json
 
 
 import signal
@@ -412,6 +413,281 @@ def main(parser_results, testConfig):
             for _, p in procs:
                 p.kill()
 
+# Benchmark mode: no interference, every process runs to completion. For each build it
+# reports per process delivered messages/s, time-to-last-delivery, retransmissions per
+# ACKed message (from the <output>.metrics dump), peak RSS and CPU time (wait4 rusage),
+# and with two builds a side-by-side table of the medians over the repetitions.
+BENCH_POLL_INTERVAL = 0.02
+
+BENCH_LOSS_PROFILES = {
+    "none": None,
+    "light": {"delay": ("10ms", "2ms"), "loss": ("1%", "25%"), "reordering": ("5%", "50%")},
+    "heavy": {"delay": ("200ms", "50ms"), "loss": ("10%", "25%"), "reordering": ("25%", "50%")},
+}
+
+
+class DeliveryCounter:
+    """Counts `d ` lines appended to an output file since the last poll."""
+
+    def __init__(self, path):
+        self.path = path
+        self.offset = 0
+        self.count = 0
+
+    def poll(self):
+        try:
+            with open(self.path, "rb") as f:
+                f.seek(self.offset)
+                data = f.read()
+        except FileNotFoundError:
+            return self.count
+        end = data.rfind(b"\n") + 1  # a partial last line is reread next time
+        self.offset += end
+        self.count += sum(1 for line in data[:end].splitlines() if line.startswith(b"d "))
+        return self.count
+
+
+def readMetrics(path):
+    counters = {}
+    try:
+        with open(path) as f:
+            for line in f:
+                words = line.split()
+                if len(words) == 2 and words[1].isdigit():
+                    counters[words[0]] = int(words[1])
+    except FileNotFoundError:
+        pass
+    return counters
+
+
+def reap(handle, block):
+    """wait4 on the process; returns its rusage once it exited, None while it runs."""
+    pid, status, rusage = os.wait4(handle.pid, 0 if block else os.WNOHANG)
+    if pid == 0:
+        return None
+    handle.returncode = os.waitstatus_to_exitcode(status)
+    return rusage
+
+
+def benchmarkOnce(binary, command, processes, messages, workDir, timeout, env):
+    validation = Validation(processes, messages)
+    if command == "perfect":
+        hostsFile, configFile = validation.generatePerfectLinksConfig(workDir)
+        expected = {pid: (processes - 1) * messages if pid == 1 else 0 for pid in range(1, processes + 1)}
+    else:
+        hostsFile, configFile = validation.generateFifoConfig(workDir)
+        expected = {pid: processes * messages for pid in range(1, processes + 1)}
+
+    outputs = {pid: os.path.join(workDir, "proc{:02d}.output".format(pid)) for pid in expected}
+    for path in outputs.values():
+        for stale in [path, path + ".metrics"]:
+            if os.path.exists(stale):
+                os.remove(stale)
+
+    counters = {pid: DeliveryCounter(path) for pid, path in outputs.items()}
+    procs = {}
+    start = time.monotonic()
+    for pid in expected:
+        cmd = [binary, "--id", str(pid), "--hosts", hostsFile, "--output", outputs[pid], configFile]
+        procs[pid] = subprocess.Popen(
+            cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, env=env
+        )
+
+    lastDelivery = {pid: None for pid in expected}
+    progress = {pid: 0 for pid in expected}
+    rusages = {}
+    complete = False
+    try:
+        while time.monotonic() - start < timeout:
+            now = time.monotonic() - start
+            for pid, counter in counters.items():
+                # the text output is written in ~4 KiB chunks (with DA_LOG=ranges only at
+                # shutdown); the metrics snapshots' deliveries counter shows the progress meanwhile
+                before = progress[pid]
+                progress[pid] = max(
+                    counter.poll(),
+                    readMetrics(outputs[pid] + ".metrics").get("deliveries", 0),
+                )
+                if progress[pid] > before:
+                    lastDelivery[pid] = now
+            # perfect-link senders exit on their own once every message is ACKed
+            for pid, handle in procs.items():
+                if pid not in rusages:
+                    rusage = reap(handle, False)
+                    if rusage is not None:
+                        rusages[pid] = rusage
+            if all(
+                progress[pid] >= expected[pid]
+                and (expected[pid] > 0 or pid in rusages)
+                for pid in expected
+            ):
+                complete = True
+                break
+            time.sleep(BENCH_POLL_INTERVAL)
+    finally:
+        for pid, handle in procs.items():
+            if pid not in rusages:
+                handle.send_signal(signal.SIGTERM)
+        for pid, handle in procs.items():
+            if pid not in rusages:
+                rusages[pid] = reap(handle, True)
+
+    results = []
+    for pid in sorted(expected):
+        deliveries = counters[pid].poll()
+        ttl = lastDelivery[pid]
+        metrics = readMetrics(outputs[pid] + ".metrics")
+        acked = metrics.get("acks_received", 0)
+        rusage = rusages[pid]
+        results.append(
+            {
+                "pid": pid,
+                "deliveries": deliveries,
+                "expected": expected[pid],
+                "ttl_s": ttl,
+                "msgs_per_s": deliveries / ttl if ttl else 0.0,
+                "retransmissions": metrics.get("retransmissions", 0),
+                "acked": acked,
+                "retx_per_msg": metrics.get("retransmissions", 0) / acked if acked else 0.0,
+                "peak_rss_mb": rusage.ru_maxrss / 1024.0,
+                "cpu_s": rusage.ru_utime + rusage.ru_stime,
+                "exit": procs[pid].returncode,
+            }
+        )
+    return {"complete": complete, "processes": results}
+
+
+def summarizeRun(run):
+    procs = run["processes"]
+    receivers = [p for p in procs if p["expected"] > 0]
+    ttl = max((p["ttl_s"] or 0.0) for p in receivers)
+    deliveries = sum(p["deliveries"] for p in receivers)
+    return OrderedDict(
+        [
+            ("msgs/s per process", sum(p["msgs_per_s"] for p in receivers) / len(receivers)),
+            ("time to last delivery s", ttl),
+            ("total deliveries/s", deliveries / ttl if ttl else 0.0),
+            ("retx per msg", sum(p["retransmissions"] for p in procs) / max(1, sum(p["acked"] for p in procs))),
+            ("peak RSS MB (max)", max(p["peak_rss_mb"] for p in procs)),
+            ("CPU s (total)", sum(p["cpu_s"] for p in procs)),
+        ]
+    )
+
+
+def median(values):
+    values = sorted(values)
+    mid = len(values) // 2
+    return values[mid] if len(values) % 2 else (values[mid - 1] + values[mid]) / 2
+
+
+def printRun(label, repetition, run):
+    print(
+        "{} run {}{}".format(label, repetition, "" if run["complete"] else "  INCOMPLETE (timeout)")
+    )
+    print(
+        "  {:>4} {:>10} {:>10} {:>12} {:>8} {:>8} {:>9} {:>8} {:>5}".format(
+            "proc", "delivered", "ttl_s", "msgs/s", "retx", "retx/msg", "rss_MB", "cpu_s", "exit"
+        )
+    )
+    for p in run["processes"]:
+        print(
+            "  {:>4} {:>10} {:>10} {:>12.0f} {:>8} {:>8.3f} {:>9.1f} {:>8.2f} {:>5}".format(
+                p["pid"],
+                p["deliveries"],
+                "-" if p["ttl_s"] is None else "{:.3f}".format(p["ttl_s"]),
+                p["msgs_per_s"],
+                p["retransmissions"],
+                p["retx_per_msg"],
+                p["peak_rss_mb"],
+                p["cpu_s"],
+                p["exit"],
+            )
+        )
+
+
+def printComparison(labels, summaries):
+    print()
+    header = "{:<26}".format("median over runs") + "".join("{:>16}".format(l) for l in labels)
+    if len(labels) == 2:
+        header += "{:>10}".format("delta")
+    print(header)
+    for metric in summaries[0]:
+        values = [s[metric] for s in summaries]
+        line = "{:<26}".format(metric) + "".join("{:>16.3f}".format(v) for v in values)
+        if len(values) == 2:
+            line += "{:>+9.1f}%".format(100.0 * (values[1] - values[0]) / values[0]) if values[0] else "{:>10}".format("-")
+        print(line)
+
+
+def benchmark(parser_results):
+    logsDir = parser_results.logsDir
+    if not os.path.isdir(logsDir):
+        raise ValueError("Directory `{}` does not exist".format(logsDir))
+
+    binaries = [os.path.abspath(b) for b in parser_results.binaries]
+    if len(binaries) > 2:
+        raise ValueError("At most two builds can be compared")
+    for binary in binaries:
+        if not os.access(binary, os.X_OK):
+            raise ValueError("`{}` is not an executable".format(binary))
+
+    env = dict(os.environ)
+    env.setdefault("DA_METRICS_INTERVAL", "100")  # progress while the text log is buffered
+    for assignment in parser_results.env:
+        key, _, value = assignment.partition("=")
+        env[key] = value
+
+    losses = BENCH_LOSS_PROFILES[parser_results.loss]
+    if losses is not None:
+        from tc import TC
+
+        print(TC(losses, needSudo=not parser_results.noSudo))
+
+    print(
+        "{} p={} m={} loss={} repeat={}".format(
+            parser_results.target,
+            parser_results.processes,
+            parser_results.messages,
+            parser_results.loss,
+            parser_results.repeat,
+        )
+    )
+
+    labels = ["A", "B"][: len(binaries)]
+    for label, binary in zip(labels, binaries):
+        print("{}: {}".format(label, binary))
+
+    runs = {label: [] for label in labels}
+    # alternate the builds so slow drift on the host hits both equally
+    for repetition in range(1, parser_results.repeat + 1):
+        for label, binary in zip(labels, binaries):
+            workDir = os.path.join(logsDir, label)
+            os.makedirs(workDir, exist_ok=True)
+            run = benchmarkOnce(
+                binary,
+                parser_results.target,
+                parser_results.processes,
+                parser_results.messages,
+                workDir,
+                parser_results.timeout,
+                env,
+            )
+            runs[label].append(run)
+            printRun(label, repetition, run)
+
+    summaries = []
+    for label in labels:
+        perRun = [summarizeRun(run) for run in runs[label]]
+        summaries.append(OrderedDict((k, median([s[k] for s in perRun])) for k in perRun[0]))
+    printComparison(labels, summaries)
+
+    if parser_results.json:
+        with open(parser_results.json, "w") as f:
+            json.dump({"config": vars(parser_results), "runs": runs}, f, indent=2)
+
+    if not all(run["complete"] for label in runs for run in runs[label]):
+        sys.exit(1)
+
 
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
@@ -487,8 +763,81 @@ if __name__ == "__main__":
         help="The number of distinct values among all proposals",
     )
 
+    parser_bench = sub_parsers.add_parser(
+        "bench", help="measure throughput and cost of perfect links or fifo broadcast"
+    )
+    parser_bench.add_argument(
+        "target", choices=["perfect", "fifo"], help="Milestone to benchmark"
+    )
+    parser_bench.add_argument(
+        "-b",
+        "--binary",
+        required=True,
+        action="append",
+        dest="binaries",
+        help="Path to a da_proc build; give it twice to compare two builds (A, then B)",
+    )
+    parser_bench.add_argument(
+        "-l",
+        "--logs",
+        required=True,
+        dest="logsDir",
+        help="Directory to store the configs, outputs and metrics of every run",
+    )
+    parser_bench.add_argument(
+        "-p",
+        "--processes",
+        required=True,
+        type=positive_int,
+        dest="processes",
+        help="Number of processes",
+    )
+    parser_bench.add_argument(
+        "-m",
+        "--messages",
+        required=True,
+        type=positive_int,
+        dest="messages",
+        help="Number of messages that each process sends or broadcasts",
+    )
+    parser_bench.add_argument(
+        "--loss",
+        choices=sorted(BENCH_LOSS_PROFILES),
+        default="none",
+        help="netem profile applied to lo with tc.py for the whole benchmark (needs root)",
+    )
+    parser_bench.add_argument(
+        "--no-sudo",
+        action="store_true",
+        dest="noSudo",
+        help="Run tc directly instead of through sudo (already root)",
+    )
+    parser_bench.add_argument(
+        "--repeat", type=positive_int, default=3, help="Runs per build (default: 3)"
+    )
+    parser_bench.add_argument(
+        "--timeout",
+        type=positive_int,
+        default=120,
+        help="Seconds before a run is stopped and reported incomplete (default: 120)",
+    )
+    parser_bench.add_argument(
+        "--env",
+        action="append",
+        default=[],
+        metavar="KEY=VALUE",
+        help="Extra environment for every process, e.g. DA_RELAY=tree",
+    )
+    parser_bench.add_argument(
+        "--json", help="Also write every run's per-process numbers to this file"
+    )
+
     results = parser.parse_args()
 
+    if results.command == "bench":
+        benchmark(results)
+        sys.exit(0)
+
     testConfig = {
         "concurrency": 8,  # How many threads are interferring with the running processes
         "attempts": 8,  # How many interferring attempts each threads does